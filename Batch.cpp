@@ -0,0 +1,90 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <exception>
+
+// 'minigit batch [-z]': runs commands read from stdin against one MiniGit, so a
+// script of thousands of add/commit steps pays for process startup and
+// repository loading once. Index and ref writes are held in memory and only
+// written at a 'flush' line and at the end of the input.
+//
+// Each line (or NUL-terminated record with -z) is one command without the
+// leading 'minigit', e.g. `commit -m "first commit"`. Arguments are split on
+// whitespace; single or double quotes group words and backslash escapes the
+// next character. Blank lines and lines starting with '#' are ignored.
+
+// Splits one command into arguments. Returns false on an unterminated quote.
+static bool splitBatchCommand(const std::string& line, std::vector<std::string>& args) {
+    args.clear();
+    std::string current;
+    bool inArg = false;
+    char quote = 0;
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (quote) {
+            if (c == quote) quote = 0;
+            else if (c == '\\' && quote == '"' && i + 1 < line.size()) current += line[++i];
+            else current += c;
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+            inArg = true;
+        } else if (c == '\\' && i + 1 < line.size()) {
+            current += line[++i];
+            inArg = true;
+        } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            if (inArg) args.push_back(current);
+            current.clear();
+            inArg = false;
+        } else {
+            current += c;
+            inArg = true;
+        }
+    }
+    if (inArg) args.push_back(current);
+    return quote == 0;
+}
+
+// Returns 0 if every command succeeded, 1 otherwise.
+static int runBatch(MiniGit& mgit, bool nulDelimited, int (*dispatch)(MiniGit&, int, char**)) {
+    mgit.setPersistent(true);
+    mgit.setDeferredWrites(true);
+
+    int status = 0;
+    std::string line;
+    std::vector<std::string> args;
+    while (std::getline(std::cin, line, nulDelimited ? '\0' : '\n')) {
+        if (!splitBatchCommand(line, args)) {
+            std::cerr << "Error: Unterminated quote in batch command: " << line << std::endl;
+            status = 1;
+            continue;
+        }
+        if (args.empty() || args[0][0] == '#') continue;
+
+        if (args[0] == "flush") {
+            if (!mgit.flushPendingWrites()) status = 1;
+            continue;
+        }
+        if (args[0] == "batch" || args[0] == "daemon") {
+            std::cerr << "Error: '" << args[0] << "' cannot be used inside a batch." << std::endl;
+            status = 1;
+            continue;
+        }
+
+        std::vector<char*> argv;
+        argv.push_back(const_cast<char*>("minigit"));
+        for (std::string& arg : args) argv.push_back(&arg[0]);
+        argv.push_back(nullptr);
+        // A command that throws fails alone; earlier lines' deferred writes
+        // must still be flushed below.
+        try {
+            if (dispatch(mgit, static_cast<int>(argv.size() - 1), argv.data()) != 0) status = 1;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            status = 1;
+        }
+    }
+
+    if (!mgit.flushPendingWrites()) status = 1;
+    mgit.setDeferredWrites(false);
+    return status;
+}
@@ -0,0 +1,444 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+// Benchmark suite for minigit. Not part of the minigit binary; build it on its own:
+//
+//   g++ -std=c++17 -O2 Benchmark.cpp -o minigit-bench
+//   ./minigit-bench --minigit=./minigit [options] > results.json
+//
+// Each run generates the same synthetic repository from the seed, times
+// init, add, commit, fast-import (the generated history), checkout, log, diff
+// and merge against it, and reports per benchmark the wall time, throughput
+// and the command's peak RSS, plus minigit's own --stats=json counters. Runs
+// are repeated on fresh repositories and summarized as min/median/max, and
+// the results are written to stdout as JSON for comparison across builds.
+
+namespace fs = std::filesystem;
+
+// Shape of the generated repository. Every file starts at a size drawn
+// log-uniformly from [minSize, maxSize] at a depth of 0..maxDepth directories.
+// The history has `commits` commits after the initial one, dealt round-robin
+// to master and `branches` topic branches (topic-1...), each forked from
+// master at its first commit. A commit edits `editDensity` of the files its
+// branch owns; files are owned by one branch each, so merges are clean.
+struct RepoShape {
+    uint64_t seed = 1;
+    size_t files = 1000;
+    size_t maxDepth = 3;
+    size_t minSize = 256;
+    size_t maxSize = 16384;
+    size_t commits = 200;
+    size_t branches = 2;
+    double editDensity = 0.02;
+};
+
+// splitmix64: small, fast and identical on every platform, unlike std::mt19937's distributions.
+class Random {
+public:
+    explicit Random(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    size_t below(size_t n) { return n ? static_cast<size_t>(next() % n) : 0; }
+    double unit() { return static_cast<double>(next() >> 11) / 9007199254740992.0; } // [0, 1)
+
+private:
+    uint64_t state;
+};
+
+class RepoGenerator {
+public:
+    static const size_t DIR_FANOUT = 8;
+    static const long long BASE_TIME = 1700000000; // Commit timestamps, so history hashes are reproducible
+
+    explicit RepoGenerator(const RepoShape& shape) : shape(shape), random(shape.seed) {
+        double low = std::log(static_cast<double>(std::max<size_t>(shape.minSize, 1)));
+        double high = std::log(static_cast<double>(std::max(shape.maxSize, shape.minSize)));
+        for (size_t i = 0; i < shape.files; ++i) {
+            std::string path;
+            size_t depth = random.below(shape.maxDepth + 1);
+            for (size_t d = 0; d < depth; ++d) path += "dir" + std::to_string(random.below(DIR_FANOUT)) + "/";
+            path += "file" + std::to_string(i) + ".txt";
+            path = "./" + path; // As 'add .' names top-level files, so staged and imported paths agree
+            size_t size = static_cast<size_t>(std::exp(low + random.unit() * (high - low)));
+            std::string content;
+            while (content.size() < size) content += randomLine();
+            paths.push_back(path);
+            contents.push_back(content);
+            totalBytes += content.size();
+        }
+    }
+
+    // Writes the initial files below `dir`.
+    bool writeFiles(const std::string& dir) const {
+        for (size_t i = 0; i < paths.size(); ++i) {
+            fs::path path = fs::path(dir) / paths[i];
+            std::error_code ec;
+            fs::create_directories(path.parent_path(), ec);
+            std::ofstream out(path, std::ios::binary);
+            out << contents[i];
+            if (!out) {
+                std::cerr << "Error: Could not write " << path.string() << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The history on top of the initial commit, as a fast-import stream.
+    // Consumes the generator's edit state, so call it once.
+    std::string historyStream() {
+        std::string out;
+        size_t lanes = shape.branches + 1;
+        std::vector<bool> started(lanes, false);
+        size_t mark = 1;
+        for (size_t c = 0; c < shape.commits; ++c) {
+            size_t lane = c % lanes;
+            std::string branch = branchName(lane);
+            if (lane > 0 && !started[lane]) out += "reset refs/heads/" + branch + "\nfrom master\n\n";
+            started[lane] = true;
+
+            std::vector<size_t> owned;
+            for (size_t i = lane; i < paths.size(); i += lanes) owned.push_back(i);
+            size_t edits = std::max<size_t>(1, static_cast<size_t>(std::lround(shape.editDensity * owned.size())));
+            std::string changes;
+            for (size_t e = 0; e < edits && !owned.empty(); ++e) {
+                size_t file = owned[random.below(owned.size())];
+                editFile(contents[file]);
+                out += "blob\nmark :" + std::to_string(mark) + "\ndata " + std::to_string(contents[file].size()) +
+                       "\n" + contents[file] + "\n";
+                changes += "M :" + std::to_string(mark++) + " " + paths[file] + "\n";
+            }
+            std::string message = "Synthetic commit " + std::to_string(c + 1);
+            out += "commit refs/heads/" + branch + "\ntimestamp " + std::to_string(BASE_TIME + 60 * (c + 1)) +
+                   " +0000\ndata " + std::to_string(message.size()) + "\n" + message + "\n" + changes + "\n";
+        }
+        return out + "done\n";
+    }
+
+    static std::string branchName(size_t lane) { return lane == 0 ? "master" : "topic-" + std::to_string(lane); }
+
+    // Commits reachable from a lane's tip: the initial commit, the master
+    // commits it forked after (or all of master's) and its own.
+    size_t commitsOn(size_t lane) const {
+        size_t lanes = shape.branches + 1;
+        size_t own = shape.commits > lane ? (shape.commits - lane + lanes - 1) / lanes : 0;
+        if (lane == 0) return 1 + own;
+        return own ? 2 + own : 1; // Forked right after master's first commit
+    }
+
+    const std::vector<std::string>& filePaths() const { return paths; }
+    size_t fileCount() const { return paths.size(); }
+    size_t bytes() const { return totalBytes; }
+
+private:
+    std::string randomLine() {
+        static const char* const words[] = {"alpha", "beta", "gamma", "delta", "index", "object", "commit", "branch",
+                                            "merge", "tree", "blob", "pack", "hash", "cache", "log", "diff"};
+        std::string line;
+        size_t count = 4 + random.below(8);
+        for (size_t w = 0; w < count; ++w) {
+            if (w) line += ' ';
+            line += words[random.below(sizeof(words) / sizeof(words[0]))];
+        }
+        return line + " " + std::to_string(random.next() % 100000) + "\n";
+    }
+
+    // Replaces one line and appends another, so edits produce small diffs.
+    void editFile(std::string& content) {
+        size_t pos = content.rfind('\n', random.below(content.size()));
+        size_t start = pos == std::string::npos ? 0 : pos + 1;
+        size_t end = content.find('\n', start);
+        end = end == std::string::npos ? content.size() : end + 1;
+        content.replace(start, end - start, randomLine());
+        content += randomLine();
+    }
+
+    RepoShape shape;
+    Random random;
+    std::vector<std::string> paths;
+    std::vector<std::string> contents;
+    size_t totalBytes = 0;
+};
+
+// One timed minigit invocation.
+struct Sample {
+    double seconds = 0;
+    long peakRssKiB = 0;
+    int status = 0;
+    std::string counters; // The --stats=json object, or "" if the command printed none
+};
+
+// Runs `minigit --stats=json <args...>` in `dir` with stdin from `input`
+// (or /dev/null) and stdout discarded. The child's peak RSS comes from wait4.
+static Sample runMinigit(const std::string& binary, const std::string& dir, const std::vector<std::string>& args,
+                         const std::string& input = "") {
+    Sample sample;
+    std::string errPath = dir + "/../bench-stderr";
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        int in = ::open(input.empty() ? "/dev/null" : input.c_str(), O_RDONLY);
+        int out = ::open("/dev/null", O_WRONLY);
+        int err = ::open(errPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (in < 0 || out < 0 || err < 0 || ::chdir(dir.c_str()) != 0) ::_exit(127);
+        ::dup2(in, 0);
+        ::dup2(out, 1);
+        ::dup2(err, 2);
+        std::vector<char*> argv;
+        std::string stats = "--stats=json";
+        argv.push_back(const_cast<char*>(binary.c_str()));
+        argv.push_back(&stats[0]);
+        for (const std::string& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+        ::execv(binary.c_str(), argv.data());
+        ::_exit(127);
+    }
+    if (pid < 0) {
+        sample.status = -1;
+        return sample;
+    }
+    int status = 0;
+    struct rusage usage;
+    ::wait4(pid, &status, 0, &usage);
+    sample.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sample.peakRssKiB = usage.ru_maxrss;
+    sample.status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+
+    std::ifstream err(errPath);
+    std::string line;
+    while (std::getline(err, line)) {
+        if (!line.empty() && line[0] == '{') sample.counters = line;
+    }
+    // minigit's own figure excludes the memory of this process it was forked from.
+    size_t field = sample.counters.find("\"peak_rss_kib\":");
+    if (field != std::string::npos) sample.peakRssKiB = std::strtol(sample.counters.c_str() + field + 15, nullptr, 10);
+    if (sample.status != 0) std::cerr << "Warning: minigit " << args[0] << " exited with " << sample.status << std::endl;
+    return sample;
+}
+
+// Adds up the samples of a command that had to be split over several
+// invocations: times and counters are summed, peak memory is the largest.
+static Sample combine(const Sample& a, const Sample& b) {
+    if (a.counters.empty()) return b;
+    Sample sum;
+    sum.seconds = a.seconds + b.seconds;
+    sum.peakRssKiB = std::max(a.peakRssKiB, b.peakRssKiB);
+    sum.status = a.status ? a.status : b.status;
+    auto fields = [](const std::string& json) {
+        std::vector<std::pair<std::string, double>> result;
+        std::stringstream ss(json.substr(1, json.size() >= 2 ? json.size() - 2 : 0));
+        std::string field;
+        while (std::getline(ss, field, ',')) {
+            size_t colon = field.find(':');
+            if (colon == std::string::npos || field.size() < 2) continue;
+            result.emplace_back(field.substr(1, colon - 2), std::strtod(field.c_str() + colon + 1, nullptr));
+        }
+        return result;
+    };
+    std::vector<std::pair<std::string, double>> left = fields(a.counters), right = fields(b.counters);
+    sum.counters = "{";
+    for (size_t i = 0; i < left.size() && i < right.size(); ++i) {
+        const std::string& key = left[i].first;
+        double value = key == "peak_rss_kib" ? std::max(left[i].second, right[i].second) : left[i].second + right[i].second;
+        char text[48];
+        if (key == "elapsed_seconds") std::snprintf(text, sizeof(text), "%.3f", value);
+        else std::snprintf(text, sizeof(text), "%.0f", value);
+        sum.counters += (i ? ",\"" : "\"") + key + "\":" + text;
+    }
+    sum.counters += "}";
+    return sum;
+}
+
+struct Benchmark {
+    std::string name;
+    std::string unit;   // What `items` counts
+    size_t items = 0;
+    size_t bytes = 0;   // Data the command processed, when known
+    std::vector<Sample> samples;
+};
+
+static std::string number(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.6f", value);
+    return buffer;
+}
+
+static std::string toJson(const RepoShape& shape, const std::string& binary, size_t runs,
+                          const std::vector<Benchmark>& benchmarks) {
+    std::string out = "{\n  \"minigit\": \"" + binary + "\",\n  \"runs\": " + std::to_string(runs) + ",\n";
+    out += "  \"shape\": {\"seed\": " + std::to_string(shape.seed) + ", \"files\": " + std::to_string(shape.files) +
+           ", \"max_depth\": " + std::to_string(shape.maxDepth) + ", \"min_size\": " + std::to_string(shape.minSize) +
+           ", \"max_size\": " + std::to_string(shape.maxSize) + ", \"commits\": " + std::to_string(shape.commits) +
+           ", \"branches\": " + std::to_string(shape.branches) + ", \"edit_density\": " + number(shape.editDensity) +
+           "},\n  \"benchmarks\": [";
+    for (size_t b = 0; b < benchmarks.size(); ++b) {
+        const Benchmark& bench = benchmarks[b];
+        std::vector<double> times;
+        long peak = 0;
+        bool failed = false;
+        for (const Sample& sample : bench.samples) {
+            times.push_back(sample.seconds);
+            peak = std::max(peak, sample.peakRssKiB);
+            failed = failed || sample.status != 0;
+        }
+        std::sort(times.begin(), times.end());
+        double median = times[times.size() / 2];
+        out += b ? ",\n" : "\n";
+        out += "    {\"name\": \"" + bench.name + "\", \"ok\": " + (failed ? "false" : "true") +
+               ", \"seconds_min\": " + number(times.front()) + ", \"seconds_median\": " + number(median) +
+               ", \"seconds_max\": " + number(times.back()) + ", \"peak_rss_kib\": " + std::to_string(peak) +
+               ", \"items\": " + std::to_string(bench.items) + ", \"unit\": \"" + bench.unit + "\"" +
+               ", \"items_per_second\": " + number(median > 0 ? bench.items / median : 0);
+        if (bench.bytes) {
+            out += ", \"bytes\": " + std::to_string(bench.bytes) +
+                   ", \"bytes_per_second\": " + number(median > 0 ? bench.bytes / median : 0);
+        }
+        const std::string& counters = bench.samples.back().counters;
+        out += ", \"counters\": " + (counters.empty() ? std::string("null") : counters) + "}";
+    }
+    return out + "\n  ]\n}\n";
+}
+
+static const size_t ADD_ARGUMENT_BYTES = 64 * 1024; // Per 'add' invocation, well below ARG_MAX
+
+static void printUsage() {
+    std::cerr << "Usage: minigit-bench [--minigit=<path>] [--runs=<n>] [--keep] [--seed=<n>] [--files=<n>]\n"
+                 "                     [--depth=<n>] [--min-size=<bytes>] [--max-size=<bytes>] [--commits=<n>]\n"
+                 "                     [--branches=<n>] [--edit-density=<fraction>]\n"
+                 "Generates a synthetic repository per run and prints timings, throughput and peak memory as JSON."
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    RepoShape shape;
+    std::string binary = "./minigit";
+    size_t runs = 3;
+    bool keep = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(0, eq), value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        try {
+            if (key == "--minigit") binary = value;
+            else if (key == "--runs") runs = std::stoul(value);
+            else if (arg == "--keep") keep = true;
+            else if (key == "--seed") shape.seed = std::stoull(value);
+            else if (key == "--files") shape.files = std::stoul(value);
+            else if (key == "--depth") shape.maxDepth = std::stoul(value);
+            else if (key == "--min-size") shape.minSize = std::stoul(value);
+            else if (key == "--max-size") shape.maxSize = std::stoul(value);
+            else if (key == "--commits") shape.commits = std::stoul(value);
+            else if (key == "--branches") shape.branches = std::stoul(value);
+            else if (key == "--edit-density") shape.editDensity = std::stod(value);
+            else {
+                printUsage();
+                return 1;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Error: Invalid value for " << key << std::endl;
+            return 1;
+        }
+    }
+    if (runs == 0 || shape.files == 0 || shape.branches >= shape.files) {
+        std::cerr << "Error: Need at least one run, one file, and more files than branches." << std::endl;
+        return 1;
+    }
+    std::error_code ec;
+    binary = fs::absolute(binary, ec).string();
+    if (::access(binary.c_str(), X_OK) != 0) {
+        std::cerr << "Error: minigit binary not found at " << binary << " (use --minigit=<path>)." << std::endl;
+        return 1;
+    }
+    ::setenv("MINIGIT_NO_DAEMON", "1", 1); // Measure the command, not a warm daemon
+
+    std::vector<Benchmark> benchmarks;
+    auto record = [&](const std::string& name, const std::string& unit, size_t items, size_t bytes,
+                      const Sample& sample) {
+        auto it = std::find_if(benchmarks.begin(), benchmarks.end(),
+                               [&](const Benchmark& bench) { return bench.name == name; });
+        if (it == benchmarks.end()) {
+            benchmarks.push_back({name, unit, items, bytes, {}});
+            it = benchmarks.end() - 1;
+        }
+        it->samples.push_back(sample);
+    };
+
+    for (size_t run = 0; run < runs; ++run) {
+        char pattern[] = "/tmp/minigit-bench-XXXXXX";
+        if (!::mkdtemp(pattern)) {
+            std::cerr << "Error: Could not create a temporary directory." << std::endl;
+            return 1;
+        }
+        std::string root = pattern, work = root + "/repo";
+        fs::create_directory(work, ec);
+        RepoGenerator generator(shape);
+        size_t files = generator.fileCount();
+        std::string topic = shape.branches ? RepoGenerator::branchName(1) : "";
+
+        record("init", "repositories", 1, 0, runMinigit(binary, work, {"init"}));
+        if (!generator.writeFiles(work)) return 1;
+        // 'add .' doesn't descend into directories, so the paths are listed,
+        // in as many invocations as the argument size limit requires.
+        Sample add;
+        std::vector<std::string> args{"add"};
+        size_t argBytes = 0;
+        for (size_t i = 0; i < files; ++i) {
+            const std::string& path = generator.filePaths()[i];
+            args.push_back(path);
+            argBytes += path.size() + 1;
+            if (argBytes >= ADD_ARGUMENT_BYTES || i + 1 == files) {
+                add = combine(add, runMinigit(binary, work, args));
+                args.resize(1);
+                argBytes = 0;
+            }
+        }
+        record("add", "files", files, generator.bytes(), add);
+        record("commit", "files", files, 0, runMinigit(binary, work, {"commit", "-m", "Initial commit"}));
+
+        std::string streamPath = root + "/history.stream";
+        std::string stream = generator.historyStream();
+        std::ofstream(streamPath, std::ios::binary) << stream;
+        record("fast-import", "commits", shape.commits, stream.size(),
+               runMinigit(binary, work, {"fast-import"}, streamPath));
+
+        // The working tree still holds the initial commit; move it to the
+        // imported tip of master first, untimed.
+        runMinigit(binary, work, {"checkout", "master"});
+        std::string target = topic.empty() ? "HEAD~1" : topic;
+        record("checkout", "files", files, 0, runMinigit(binary, work, {"checkout", target}));
+        runMinigit(binary, work, {"checkout", "master"});
+
+        record("log", "commits", generator.commitsOn(0), 0, runMinigit(binary, work, {"log"}));
+        size_t back = std::min<size_t>(generator.commitsOn(0) - 1, 10);
+        record("diff", "commits", back, 0, runMinigit(binary, work, {"diff", "master~" + std::to_string(back), "master"}));
+        if (!topic.empty()) record("merge", "files", files, 0, runMinigit(binary, work, {"merge", topic}));
+
+        if (keep) std::cerr << "Kept run " << run + 1 << " in " << root << std::endl;
+        else fs::remove_all(root, ec);
+    }
+
+    std::cout << toJson(shape, binary, runs, benchmarks);
+    return 0;
+}
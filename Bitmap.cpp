@@ -0,0 +1,157 @@
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <sstream>
+#include <cstdint>
+
+// EWAH (Enhanced Word-Aligned Hybrid) compressed bitmap.
+// The buffer is a sequence of marker words, each followed by literal words:
+//   bit 0       value of the run of clean (all-0 or all-1) words
+//   bits 1-32   number of clean words in the run
+//   bits 33-63  number of literal words that follow the marker
+// Reachability sets of commits are mostly long runs of ones (old history)
+// followed by a few literal words, so they compress to a handful of words.
+class EwahBitmap {
+public:
+    static EwahBitmap compress(const std::vector<uint64_t>& words) {
+        EwahBitmap bitmap;
+        size_t i = 0;
+        while (i < words.size()) {
+            uint64_t runBit = words[i] == ~uint64_t(0) ? 1 : 0;
+            uint64_t cleanWord = runBit ? ~uint64_t(0) : 0;
+            uint64_t runLength = 0;
+            while (i < words.size() && runLength < 0xffffffffULL && words[i] == cleanWord) {
+                ++runLength;
+                ++i;
+            }
+            size_t literalStart = i;
+            while (i < words.size() && i - literalStart < 0x7fffffffULL && words[i] != 0 && words[i] != ~uint64_t(0)) ++i;
+            uint64_t literals = i - literalStart;
+            bitmap.buffer.push_back(runBit | (runLength << 1) | (literals << 33));
+            bitmap.buffer.insert(bitmap.buffer.end(), words.begin() + literalStart, words.begin() + i);
+        }
+        return bitmap;
+    }
+
+    // Expands into `wordCount` plain words (padding with zeros).
+    std::vector<uint64_t> decompress(size_t wordCount) const {
+        std::vector<uint64_t> words;
+        words.reserve(wordCount);
+        size_t i = 0;
+        while (i < buffer.size()) {
+            uint64_t marker = buffer[i++];
+            uint64_t runLength = (marker >> 1) & 0xffffffffULL;
+            uint64_t literals = marker >> 33;
+            words.insert(words.end(), runLength, (marker & 1) ? ~uint64_t(0) : 0);
+            for (uint64_t j = 0; j < literals && i < buffer.size(); ++j) words.push_back(buffer[i++]);
+        }
+        words.resize(wordCount, 0);
+        return words;
+    }
+
+    std::string toHex() const {
+        std::stringstream ss;
+        ss << std::hex;
+        for (size_t i = 0; i < buffer.size(); ++i) {
+            if (i) ss << ',';
+            ss << buffer[i];
+        }
+        return ss.str();
+    }
+
+    static EwahBitmap fromHex(const std::string& hex) {
+        EwahBitmap bitmap;
+        std::stringstream ss(hex);
+        std::string word;
+        while (std::getline(ss, word, ',')) {
+            if (!word.empty()) bitmap.buffer.push_back(std::stoull(word, nullptr, 16));
+        }
+        return bitmap;
+    }
+
+    size_t compressedWords() const { return buffer.size(); }
+
+private:
+    std::vector<uint64_t> buffer;
+};
+
+// Reachability bitmaps (.minigit/bitmaps) over a stable ordering of all
+// objects reachable from the refs. Objects are numbered oldest commit first,
+// each commit followed by the blobs it introduced, so the set reachable from
+// any commit is mostly one long run of ones.
+// File layout:
+//   minigit-bitmaps 1
+//   <hash> <c|b>                one line per object, in bit order
+//   bitmap <commit> <ewah-hex>  reachability of selected commits
+class BitmapIndex {
+public:
+    static const char* header() { return "minigit-bitmaps 1"; }
+
+    void addObject(const std::string& hash, bool isCommit) {
+        if (positions.count(hash)) return;
+        positions[hash] = objects.size();
+        objects.push_back(hash);
+        commitFlags.push_back(isCommit);
+    }
+
+    // Position of an object in the ordering, or -1 if it isn't covered.
+    long position(const std::string& hash) const {
+        auto it = positions.find(hash);
+        return it == positions.end() ? -1 : static_cast<long>(it->second);
+    }
+
+    size_t objectCount() const { return objects.size(); }
+    size_t wordCount() const { return (objects.size() + 63) / 64; }
+    const std::string& objectAt(size_t pos) const { return objects[pos]; }
+
+    // Plain bitmap with one bit per commit in the ordering.
+    std::vector<uint64_t> commitMask() const {
+        std::vector<uint64_t> mask(wordCount(), 0);
+        for (size_t i = 0; i < commitFlags.size(); ++i) {
+            if (commitFlags[i]) mask[i / 64] |= uint64_t(1) << (i % 64);
+        }
+        return mask;
+    }
+
+    const EwahBitmap* find(const std::string& commit) const {
+        auto it = bitmaps.find(commit);
+        return it == bitmaps.end() ? nullptr : &it->second;
+    }
+
+    void setBitmap(const std::string& commit, const EwahBitmap& bitmap) { bitmaps[commit] = bitmap; }
+    size_t bitmapCount() const { return bitmaps.size(); }
+
+    std::string serialize() const {
+        std::string out = std::string(header()) + "\n";
+        for (size_t i = 0; i < objects.size(); ++i) {
+            out += objects[i] + (commitFlags[i] ? " c\n" : " b\n");
+        }
+        for (const auto& entry : bitmaps) {
+            out += "bitmap " + entry.first + " " + entry.second.toHex() + "\n";
+        }
+        return out;
+    }
+
+    static BitmapIndex deserialize(const std::string& data) {
+        BitmapIndex index;
+        std::stringstream ss(data);
+        std::string line;
+        if (!std::getline(ss, line) || line != header()) return index;
+        while (std::getline(ss, line)) {
+            if (line.rfind("bitmap ", 0) == 0) {
+                size_t space = line.find(' ', 7);
+                if (space == std::string::npos) continue;
+                index.bitmaps[line.substr(7, space - 7)] = EwahBitmap::fromHex(line.substr(space + 1));
+            } else if (line.size() > 2 && line[line.size() - 2] == ' ') {
+                index.addObject(line.substr(0, line.size() - 2), line.back() == 'c');
+            }
+        }
+        return index;
+    }
+
+private:
+    std::vector<std::string> objects;
+    std::vector<bool> commitFlags;
+    std::unordered_map<std::string, size_t> positions;
+    std::unordered_map<std::string, EwahBitmap> bitmaps;
+};
@@ -0,0 +1,62 @@
+#include <string>
+#include <vector>
+#include <utility>
+#include <istream>
+
+// A bundle moves a slice of history as one file:
+//   # minigit bundle v1
+//   -<commit>                    prerequisite: the receiver must already have it
+//   <commit> <ref>               ref carried by the bundle, e.g. refs/heads/master
+//   <blank line>
+//   <hash> <length>\n<bytes>     one record per object, blobs before commits
+// The records are self-delimiting, so a bundle is written and read as a
+// stream without an index; unbundle builds the pack index as it reads.
+struct BundleHeader {
+    static const char* signature() { return "# minigit bundle v1"; }
+
+    std::vector<std::string> prerequisites;
+    std::vector<std::pair<std::string, std::string>> refs; // Commit, ref name
+
+    std::string serialize() const {
+        std::string out = std::string(signature()) + "\n";
+        for (const std::string& hash : prerequisites) out += "-" + hash + "\n";
+        for (const auto& ref : refs) out += ref.first + " " + ref.second + "\n";
+        return out + "\n";
+    }
+
+    // Ref names from a bundle become paths under .minigit, so each one must be
+    // a plain relative path: no empty, '.' or '..' components, no leading '/',
+    // no control characters.
+    static bool isSafeRefName(const std::string& name) {
+        if (name.empty() || name[0] == '/') return false;
+        for (unsigned char c : name) {
+            if (c < 0x20 || c == 0x7f) return false;
+        }
+        size_t start = 0;
+        while (start <= name.size()) {
+            size_t end = name.find('/', start);
+            if (end == std::string::npos) end = name.size();
+            std::string component = name.substr(start, end - start);
+            if (component.empty() || component == "." || component == "..") return false;
+            start = end + 1;
+        }
+        return true;
+    }
+
+    // Reads the header up to and including the blank line.
+    static bool read(std::istream& in, BundleHeader& header) {
+        std::string line;
+        if (!std::getline(in, line) || line != signature()) return false;
+        while (std::getline(in, line)) {
+            if (line.empty()) return true;
+            if (line[0] == '-') {
+                header.prerequisites.push_back(line.substr(1));
+                continue;
+            }
+            size_t space = line.find(' ');
+            if (space == std::string::npos) return false;
+            header.refs.emplace_back(line.substr(0, space), line.substr(space + 1));
+        }
+        return false;
+    }
+};
@@ -0,0 +1,163 @@
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <sstream>
+#include <cstdint>
+#include <algorithm>
+#include <cstdlib>
+#include <cerrno>
+
+// Bloom filter over the paths a commit changed relative to its parent.
+// A negative answer means the commit definitely did not touch the path, so
+// path-limited history can skip it without reading any objects.
+class ChangedPathBloom {
+public:
+    static const unsigned BITS_PER_ENTRY = 10;
+    static const unsigned NUM_HASHES = 7;
+
+    // Adds every path and all of its parent directories, so that
+    // 'log -- dir' can use the filter as well as 'log -- dir/file'.
+    static ChangedPathBloom build(const std::vector<std::string>& paths) {
+        std::vector<std::string> keys;
+        for (const std::string& path : paths) {
+            keys.push_back(path);
+            for (size_t pos = path.find('/'); pos != std::string::npos; pos = path.find('/', pos + 1)) {
+                keys.push_back(path.substr(0, pos));
+            }
+        }
+        ChangedPathBloom bloom;
+        size_t words = (keys.size() * BITS_PER_ENTRY + 63) / 64;
+        bloom.bits.assign(words == 0 ? 1 : words, 0);
+        for (const std::string& key : keys) bloom.add(key);
+        return bloom;
+    }
+
+    bool mightContain(const std::string& path) const {
+        if (bits.empty()) return true; // No filter: cannot rule anything out
+        uint64_t h1, h2;
+        hashes(path, h1, h2);
+        uint64_t nbits = bits.size() * 64;
+        for (unsigned i = 0; i < NUM_HASHES; ++i) {
+            uint64_t bit = (h1 + i * h2) % nbits;
+            if (!(bits[bit / 64] & (uint64_t(1) << (bit % 64)))) return false;
+        }
+        return true;
+    }
+
+    std::string toHex() const {
+        static const char* digits = "0123456789abcdef";
+        std::string hex;
+        hex.reserve(bits.size() * 16);
+        for (uint64_t word : bits) {
+            for (int shift = 60; shift >= 0; shift -= 4) hex += digits[(word >> shift) & 0xf];
+        }
+        return hex;
+    }
+
+    static ChangedPathBloom fromHex(const std::string& hex) {
+        ChangedPathBloom bloom;
+        for (size_t i = 0; i + 16 <= hex.size(); i += 16) {
+            bloom.bits.push_back(std::stoull(hex.substr(i, 16), nullptr, 16));
+        }
+        return bloom;
+    }
+
+private:
+    void add(const std::string& key) {
+        uint64_t h1, h2;
+        hashes(key, h1, h2);
+        uint64_t nbits = bits.size() * 64;
+        for (unsigned i = 0; i < NUM_HASHES; ++i) {
+            uint64_t bit = (h1 + i * h2) % nbits;
+            bits[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+    }
+
+    // Two independent hashes combined by double hashing (FNV-1a and djb2).
+    static void hashes(const std::string& key, uint64_t& h1, uint64_t& h2) {
+        h1 = 1469598103934665603ULL;
+        h2 = 5381;
+        for (unsigned char c : key) {
+            h1 = (h1 ^ c) * 1099511628211ULL;
+            h2 = ((h2 << 5) + h2) + c;
+        }
+        h2 |= 1; // Keep the probe step odd so probes don't collapse
+    }
+
+    std::vector<uint64_t> bits;
+};
+
+// Side file (.minigit/commit-graph) caching per-commit metadata that history
+// walks need, so they don't have to read and parse each commit object.
+// One line per commit, ordered by commit time: "<hash> <parent> <time> <bloom-hex>".
+// Version 1 files (without the time column) are still read.
+class CommitGraph {
+public:
+    struct Entry {
+        std::string parentHash;
+        long long time;
+        ChangedPathBloom bloom;
+    };
+
+    static const char* header() { return "minigit-commit-graph 2"; }
+
+    static CommitGraph deserialize(const std::string& data) {
+        CommitGraph graph;
+        std::stringstream ss(data);
+        std::string line;
+        if (!std::getline(ss, line)) return graph;
+        if (line != header() && line != "minigit-commit-graph 1") return graph;
+        bool allTimes = true;
+        while (std::getline(ss, line)) {
+            // Version 1 lines have no time column; makeCommit may append version 2
+            // lines to such a file, so decide per line.
+            std::stringstream ls(line);
+            std::vector<std::string> fields;
+            std::string field;
+            while (ls >> field) fields.push_back(field);
+            if (fields.size() != 3 && fields.size() != 4) continue;
+            bool hasTime = fields.size() == 4;
+            allTimes = allTimes && hasTime;
+            std::string parent = fields[1] == "-" ? "" : fields[1];
+            long long time = 0;
+            if (hasTime) {
+                char* end = nullptr;
+                errno = 0;
+                time = std::strtoll(fields[2].c_str(), &end, 10);
+                if (*end != '\0' || errno == ERANGE) continue; // Corrupt line: read the commit instead
+            }
+            graph.entries[fields[0]] = Entry{parent, time, ChangedPathBloom::fromHex(fields.back())};
+        }
+        graph.timesKnown = allTimes;
+        return graph;
+    }
+
+    static std::string serializeEntry(const std::string& hash, const Entry& entry) {
+        return hash + " " + (entry.parentHash.empty() ? "-" : entry.parentHash) + " " +
+               std::to_string(entry.time) + " " + entry.bloom.toHex() + "\n";
+    }
+
+    std::string serialize() const {
+        std::vector<std::pair<long long, std::string>> order;
+        order.reserve(entries.size());
+        for (const auto& entry : entries) order.emplace_back(entry.second.time, entry.first);
+        std::sort(order.begin(), order.end());
+
+        std::string out = std::string(header()) + "\n";
+        for (const auto& item : order) out += serializeEntry(item.second, entries.at(item.second));
+        return out;
+    }
+
+    const Entry* find(const std::string& hash) const {
+        auto it = entries.find(hash);
+        return it == entries.end() ? nullptr : &it->second;
+    }
+
+    // Whether every entry has the time column.
+    bool hasTimes() const { return timesKnown; }
+
+    std::unordered_map<std::string, Entry> entries;
+
+private:
+    bool timesKnown = false;
+};
@@ -0,0 +1,231 @@
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <exception>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Persistent server mode. 'minigit daemon' listens on DAEMON_SOCKET and runs
+// each client's command against one long-lived MiniGit, whose caches (commits,
+// packs, staging area, refs) stay warm between commands.
+//
+// Protocol, one request per connection:
+//   client -> server  u32 length, then the arguments separated by '\0';
+//                     stdin/stdout/stderr travel alongside as SCM_RIGHTS
+//   server -> client  i32 exit status, once the command has finished
+// The server runs the command with the client's descriptors installed as its
+// own 0/1/2, so output streams straight to the client's terminal or pipe.
+
+const std::string DAEMON_SOCKET = MINIGIT_DIR + "daemon.sock";
+
+static bool fillSocketAddress(sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (DAEMON_SOCKET.size() >= sizeof(addr.sun_path)) return false;
+    std::memcpy(addr.sun_path, DAEMON_SOCKET.c_str(), DAEMON_SOCKET.size() + 1);
+    return true;
+}
+
+static bool readFully(int fd, void* data, size_t len) {
+    char* p = static_cast<char*>(data);
+    while (len > 0) {
+        ssize_t n = ::read(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static bool writeFully(int fd, const void* data, size_t len) {
+    const char* p = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t n = ::write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Sends the request frame with our stdio descriptors attached.
+static bool sendRequest(int sock, const std::vector<std::string>& args) {
+    std::string payload;
+    for (const std::string& arg : args) {
+        payload += arg;
+        payload += '\0';
+    }
+    uint32_t length = static_cast<uint32_t>(payload.size());
+
+    int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    char control[CMSG_SPACE(sizeof(fds))];
+    std::memset(control, 0, sizeof(control));
+    iovec iov{&length, sizeof(length)};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    ssize_t sent;
+    do {
+        sent = ::sendmsg(sock, &msg, 0);
+    } while (sent < 0 && errno == EINTR);
+    if (sent != static_cast<ssize_t>(sizeof(length))) return false;
+    return writeFully(sock, payload.data(), payload.size());
+}
+
+// Receives a request frame; `fds` gets the client's stdin/stdout/stderr.
+static bool receiveRequest(int sock, std::vector<std::string>& args, int fds[3]) {
+    uint32_t length = 0;
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    iovec iov{&length, sizeof(length)};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t got;
+    do {
+        got = ::recvmsg(sock, &msg, 0);
+    } while (got < 0 && errno == EINTR);
+    if (got != static_cast<ssize_t>(sizeof(length))) return false;
+
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int))) return false;
+    std::memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+
+    std::string payload(length, '\0');
+    if (length > 0 && !readFully(sock, &payload[0], length)) {
+        for (int i = 0; i < 3; ++i) ::close(fds[i]);
+        return false;
+    }
+    args.clear();
+    size_t start = 0;
+    for (size_t i = 0; i < payload.size(); ++i) {
+        if (payload[i] == '\0') {
+            args.push_back(payload.substr(start, i - start));
+            start = i + 1;
+        }
+    }
+    return true;
+}
+
+// Runs the command through a daemon if one is listening. Returns false when
+// there is no usable daemon, in which case the caller runs the command itself.
+// Once the request is sent the daemon owns the command (and may have consumed
+// our stdin), so a missing reply is a failure, never a reason to run it again.
+static bool runThroughDaemon(const std::vector<std::string>& args, int& status) {
+    if (getenv("MINIGIT_NO_DAEMON")) return false;
+    if (Trace::enabled()) return false; // The spans must be recorded in this process
+    sockaddr_un addr;
+    if (!fillSocketAddress(addr)) return false;
+    if (::access(DAEMON_SOCKET.c_str(), F_OK) != 0) return false;
+
+    int sock = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) return false;
+    if (::connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::close(sock); // Stale socket from a daemon that is gone
+        return false;
+    }
+    if (!sendRequest(sock, args)) {
+        ::close(sock);
+        return false;
+    }
+    int32_t reply = 0;
+    if (readFully(sock, &reply, sizeof(reply))) {
+        status = reply;
+    } else {
+        std::cerr << "Error: The MiniGit daemon died while running the command." << std::endl;
+        status = 1;
+    }
+    ::close(sock);
+    return true;
+}
+
+// Serves commands until a 'daemon --stop' request arrives. `dispatch` is the
+// CLI's command handler; it is run with the client's stdio as fds 0/1/2.
+static int serveDaemon(MiniGit& mgit, int (*dispatch)(MiniGit&, int, char**)) {
+    sockaddr_un addr;
+    if (!fillSocketAddress(addr)) {
+        std::cerr << "Error: Socket path too long: " << DAEMON_SOCKET << std::endl;
+        return 1;
+    }
+    int server = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+        std::cerr << "Error: Could not create socket: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    ::unlink(DAEMON_SOCKET.c_str());
+    if (::bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(server, 16) != 0) {
+        std::cerr << "Error: Could not listen on " << DAEMON_SOCKET << ": " << std::strerror(errno) << std::endl;
+        ::close(server);
+        return 1;
+    }
+    mgit.setPersistent(true);
+    std::cout << "MiniGit daemon listening on " << DAEMON_SOCKET << std::endl;
+
+    int savedFds[3] = {::dup(STDIN_FILENO), ::dup(STDOUT_FILENO), ::dup(STDERR_FILENO)};
+    bool running = true;
+    while (running) {
+        int client = ::accept(server, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        std::vector<std::string> args;
+        int clientFds[3];
+        if (!receiveRequest(client, args, clientFds)) {
+            ::close(client);
+            continue;
+        }
+
+        int32_t status = 0;
+        if (args.size() >= 2 && args[0] == "daemon" && args[1] == "--stop") {
+            running = false;
+        } else {
+            for (int i = 0; i < 3; ++i) ::dup2(clientFds[i], i);
+            std::cin.clear();
+            clearerr(stdin);
+            mgit.revalidateCaches();
+            std::vector<char*> argv;
+            argv.push_back(const_cast<char*>("minigit"));
+            for (std::string& arg : args) argv.push_back(&arg[0]);
+            argv.push_back(nullptr);
+            // A command that throws fails on its own; the daemon keeps serving.
+            try {
+                status = dispatch(mgit, static_cast<int>(argv.size() - 1), argv.data());
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                status = 1;
+            }
+            std::cout.flush();
+            std::cerr.flush();
+            fflush(stdout);
+            for (int i = 0; i < 3; ++i) ::dup2(savedFds[i], i);
+        }
+        for (int i = 0; i < 3; ++i) ::close(clientFds[i]);
+        writeFully(client, &status, sizeof(status));
+        ::close(client);
+    }
+
+    ::close(server);
+    ::unlink(DAEMON_SOCKET.c_str());
+    for (int i = 0; i < 3; ++i) ::close(savedFds[i]);
+    std::cout << "MiniGit daemon stopped." << std::endl;
+    return 0;
+}
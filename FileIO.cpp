@@ -0,0 +1,131 @@
+#include <string>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Whole-file reads and writes straight on POSIX descriptors. A read fstats
+// the file and fills a buffer of exactly that size (mapping large files
+// instead of reading them in pieces); a write is a single write(2), repeated
+// only if the kernel takes less. Every function returns 0 or an errno value,
+// so a missing file (ENOENT) can be told apart from an empty one.
+struct FileIO {
+    static const size_t MMAP_THRESHOLD = 1 << 20; // Files at least this big are mapped
+
+    static int read(const std::string& path, std::string& content) {
+        content.clear();
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return errno;
+        struct stat st;
+        if (::fstat(fd, &st) != 0) return closeWith(fd, errno);
+        if (S_ISDIR(st.st_mode)) return closeWith(fd, EISDIR);
+        size_t size = static_cast<size_t>(st.st_size);
+        if (size >= MMAP_THRESHOLD) {
+            void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                ::madvise(mapped, size, MADV_SEQUENTIAL);
+                content.assign(static_cast<const char*>(mapped), size);
+                ::munmap(mapped, size);
+                PerfCounters::bump(perfCounters.bytesRead, size);
+                return closeWith(fd, 0);
+            }
+        }
+        content.resize(size);
+        size_t done = 0;
+        while (done < size) {
+            ssize_t n = ::pread(fd, &content[done], size - done, static_cast<off_t>(done));
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) return closeWith(fd, errno);
+            if (n == 0) break; // Truncated since the fstat
+            done += static_cast<size_t>(n);
+        }
+        content.resize(done);
+        PerfCounters::bump(perfCounters.bytesRead, done);
+        return closeWith(fd, 0);
+    }
+
+    // Reads `length` bytes at `offset`, e.g. one object out of a pack.
+    // A file too short to hold them is reported as EIO.
+    static int readAt(const std::string& path, unsigned long long offset, size_t length, std::string& content) {
+        content.resize(length);
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return errno;
+        size_t done = 0;
+        while (done < length) {
+            ssize_t n = ::pread(fd, &content[done], length - done, static_cast<off_t>(offset + done));
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) return closeWith(fd, errno);
+            if (n == 0) return closeWith(fd, EIO);
+            done += static_cast<size_t>(n);
+        }
+        PerfCounters::bump(perfCounters.bytesRead, length);
+        return closeWith(fd, 0);
+    }
+
+    // Replaces the file's contents, or appends to them with `append`.
+    static int write(const std::string& path, const std::string& content, bool append = false) {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC), 0644);
+        if (fd < 0) return errno;
+        size_t done = 0;
+        while (done < content.size()) {
+            ssize_t n = ::write(fd, content.data() + done, content.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) return closeWith(fd, errno);
+            done += static_cast<size_t>(n);
+        }
+        PerfCounters::bump(perfCounters.bytesWritten, done);
+        return ::close(fd) == 0 ? 0 : errno;
+    }
+
+    static std::string message(int error) { return std::strerror(error); }
+
+private:
+    static int closeWith(int fd, int error) {
+        ::close(fd);
+        return error;
+    }
+};
+
+// A read-only mapping of a whole file, for data that is searched in place
+// rather than copied out (e.g. the multi-pack index).
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    // Returns 0 or an errno value; an empty file can't be mapped (EINVAL).
+    int open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return errno;
+        struct stat st;
+        int error = ::fstat(fd, &st) != 0 ? errno : st.st_size == 0 ? EINVAL : 0;
+        void* mapped = MAP_FAILED;
+        if (!error) {
+            mapped = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) error = errno;
+        }
+        ::close(fd);
+        if (error) return error;
+        bytes = static_cast<const char*>(mapped);
+        length = static_cast<size_t>(st.st_size);
+        return 0;
+    }
+
+    void close() {
+        if (bytes) ::munmap(const_cast<char*>(bytes), length);
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+};
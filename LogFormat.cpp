@@ -0,0 +1,93 @@
+#include <string>
+#include <vector>
+
+// A --format template compiled once per `log` invocation.
+// Supported placeholders:
+//   %H  full commit hash        %h  abbreviated commit hash
+//   %P  full parent hash        %p  abbreviated parent hash
+//   %s  commit message          %ad commit date
+//   %at commit date as epoch seconds
+//   %n  newline                 %%  literal '%'
+// Anything else is copied through verbatim.
+class LogFormat {
+public:
+    enum class Field { Literal, Hash, ShortHash, Parent, ShortParent, Message, Date, EpochDate };
+
+    struct Segment {
+        Field field;
+        std::string text; // Only used for Field::Literal
+    };
+
+    static LogFormat compile(const std::string& tmpl) {
+        LogFormat fmt;
+        std::string literal;
+        for (size_t i = 0; i < tmpl.size(); ++i) {
+            char c = tmpl[i];
+            if (c != '%' || i + 1 >= tmpl.size()) {
+                literal += c;
+                continue;
+            }
+            char next = tmpl[i + 1];
+            Field field = Field::Literal;
+            size_t consumed = 1;
+            switch (next) {
+                case 'H': field = Field::Hash; break;
+                case 'h': field = Field::ShortHash; break;
+                case 'P': field = Field::Parent; break;
+                case 'p': field = Field::ShortParent; break;
+                case 's': field = Field::Message; break;
+                case 'n': literal += '\n'; i += 1; continue;
+                case '%': literal += '%'; i += 1; continue;
+                case 'a':
+                    if (i + 2 < tmpl.size() && tmpl[i + 2] == 'd') {
+                        field = Field::Date;
+                        consumed = 2;
+                    } else if (i + 2 < tmpl.size() && tmpl[i + 2] == 't') {
+                        field = Field::EpochDate;
+                        consumed = 2;
+                    }
+                    break;
+                default: break;
+            }
+            if (field == Field::Literal) {
+                literal += c;
+                continue;
+            }
+            if (!literal.empty()) {
+                fmt.segments.push_back({Field::Literal, literal});
+                literal.clear();
+            }
+            fmt.segments.push_back({field, ""});
+            if (field == Field::Date) fmt.needsDate = true;
+            i += consumed;
+        }
+        if (!literal.empty()) {
+            fmt.segments.push_back({Field::Literal, literal});
+        }
+        return fmt;
+    }
+
+    // Appends the rendered template for one commit to `out`.
+    // `date` is passed separately so callers only format it when usesDate().
+    void render(std::string& out, const std::string& hash, const std::string& parent,
+                const std::string& message, const std::string& date, long long epoch) const {
+        for (const Segment& seg : segments) {
+            switch (seg.field) {
+                case Field::Literal: out += seg.text; break;
+                case Field::Hash: out += hash; break;
+                case Field::ShortHash: out += hash.substr(0, 7); break;
+                case Field::Parent: out += parent; break;
+                case Field::ShortParent: out += parent.substr(0, 7); break;
+                case Field::Message: out += message; break;
+                case Field::Date: out += date; break;
+                case Field::EpochDate: out += std::to_string(epoch); break;
+            }
+        }
+    }
+
+    bool usesDate() const { return needsDate; }
+
+private:
+    std::vector<Segment> segments;
+    bool needsDate = false;
+};
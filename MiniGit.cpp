@@ -2,21 +2,120 @@
 #include <map>
 #include <vector>
 #include <filesystem> // For direct filesystem operations
+#include "Trace.cpp"
+#include "Stats.cpp"
 #include "Commit.cpp"
+#include "OutputBuffer.cpp"
+#include "LogFormat.cpp"
+#include "CommitGraph.cpp"
+#include "Revision.cpp"
+#include "Bitmap.cpp"
+#include "FileIO.cpp"
+#include "Pack.cpp"
+#include "ObjectCache.cpp"
+#include "ObjectFilter.cpp"
+#include "ReadAhead.cpp"
+#include "Tar.cpp"
+#include "Bundle.cpp"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <set>     // For std::set in merge/LCA
+#include <climits>
+#include <unordered_map>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <unordered_set>
+#include <iterator>
+#include <cctype>
+#include <cerrno>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
 
 namespace fs = std::filesystem; // Shorter alias for std::filesystem
 
 // Define constants for repository structure
 const std::string MINIGIT_DIR = ".minigit/";
 const std::string OBJECTS_DIR = MINIGIT_DIR + "objects/";
+const std::string PACK_DIR = OBJECTS_DIR + "pack/";
+const std::string MULTI_PACK_INDEX_FILE = PACK_DIR + "multi-pack-index"; // One sorted table over many packs
+const std::string ALTERNATES_FILE = OBJECTS_DIR + "info/alternates"; // Other object directories to read from
 const std::string REFS_DIR = MINIGIT_DIR + "refs/";
 const std::string HEAD_FILE = REFS_DIR + "HEAD";
 const std::string HEADS_DIR = REFS_DIR + "heads/";
+const std::string REMOTES_DIR = REFS_DIR + "remotes/"; // Remote-tracking refs, e.g. remotes/origin/master
+const std::string ORIGIN_FILE = MINIGIT_DIR + "origin"; // Path of the repository this one was cloned from
+const std::string PROMISOR_FILE = MINIGIT_DIR + "promisor"; // Partial clone: repository that supplies missing blobs
+const std::string SHALLOW_FILE = MINIGIT_DIR + "shallow"; // Shallow clone: commits whose parents are treated as absent
 const std::string INDEX_FILE = MINIGIT_DIR + "index"; // Staging area
+const std::string COMMIT_GRAPH_FILE = MINIGIT_DIR + "commit-graph"; // Cached parents + changed-path filters
+const std::string BITMAPS_FILE = MINIGIT_DIR + "bitmaps"; // Reachability bitmaps
+const size_t OBJECT_CACHE_BUDGET = 32 << 20; // Default object cache size; MINIGIT_OBJECT_CACHE overrides it
+const size_t OBJECT_FILTER_THRESHOLD = 64; // Existence checks a command makes before the object filter is built
+const size_t LOG_READ_AHEAD = 64; // Commits 'log' hints to the read-ahead thread at a time, when known in advance
+const size_t BITMAP_INTERVAL = 100; // Store a bitmap for every Nth commit (plus every ref tip)
+const size_t NEGOTIATION_BATCH = 32; // Commits offered as "have" per fetch negotiation round
+const size_t ARCHIVE_READ_AHEAD = 64; // Files 'archive' may have read but not yet written
+const long long GC_DEFAULT_PRUNE_AGE = 14 * 24 * 60 * 60; // Keep unreachable loose objects younger than two weeks
+
+#include "Remote.cpp" // Uses the repository layout above
+
+// Options for 'log'
+struct LogOptions {
+    long maxCount = -1;     // -n <count>; negative means no limit
+    bool oneline = false;   // --oneline
+    std::string format;     // --format=<template>; empty means the default layout
+    std::vector<std::string> paths; // -- <path>...; only show commits touching these
+    long long since = LLONG_MIN;    // --since=<date>
+    long long until = LLONG_MAX;    // --until=<date>
+    std::vector<std::string> revisions; // <rev>... / A..B / --not; empty means HEAD
+};
+
+// Identity of a file's current contents, used to notice changes made by other
+// processes. A signature taken within RACY_SECONDS of the file's mtime is
+// "racy" (a same-size rewrite in the same timestamp tick would go unnoticed),
+// so it is never trusted for a cache hit.
+struct FileSignature {
+    bool exists = false;
+    bool racy = true;
+    dev_t device = 0;
+    ino_t inode = 0;
+    off_t size = 0;
+    long long mtimeNanos = 0;
+
+    static const long long RACY_SECONDS = 2;
+
+    static FileSignature of(const std::string& path) {
+        FileSignature sig;
+        struct stat st;
+        PerfCounters::bump(perfCounters.filesStatted);
+        if (::stat(path.c_str(), &st) != 0) return sig;
+        sig.exists = true;
+        sig.device = st.st_dev;
+        sig.inode = st.st_ino;
+        sig.size = st.st_size;
+        sig.mtimeNanos = static_cast<long long>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+        sig.racy = std::time(nullptr) - st.st_mtim.tv_sec < RACY_SECONDS;
+        return sig;
+    }
+
+    bool sameFile(const FileSignature& other) const {
+        return exists == other.exists && device == other.device && inode == other.inode &&
+               size == other.size && mtimeNanos == other.mtimeNanos;
+    }
+};
+
+// Objects reachable from a set of commits: bits for objects covered by the
+// bitmap index, plus explicit sets for objects written after it was built.
+struct Reachability {
+    std::vector<uint64_t> bits;
+    std::set<std::string> extraCommits;
+    std::set<std::string> extraBlobs;
+};
 
 class MiniGit {
 private:
@@ -24,8 +123,77 @@ private:
     bool createDirectory(const std::string& path);
     bool fileExists(const std::string& path);
     std::string readFile(const std::string& path);
+    bool readFile(const std::string& path, std::string& content);
     bool writeFile(const std::string& path, const std::string& content);
+    bool appendFile(const std::string& path, const std::string& content);
     bool removeFile(const std::string& path);
+    std::unordered_set<std::string> knownDirectories; // Directories createDirectory has already seen or made
+    std::mutex knownDirectoriesLock;
+
+    // Object store: loose objects in OBJECTS_DIR, then packs in PACK_DIR, then
+    // the object directories listed in ALTERNATES_FILE (read-only)
+    struct AlternateStore {
+        std::string objectsDir;
+        std::vector<PackIndex> packs;
+    };
+    MultiPackIndex multiPackIndex;
+    std::vector<PackIndex> packs; // Only the packs multiPackIndex doesn't cover
+    std::vector<AlternateStore> alternates;
+    bool packsLoaded = false;
+    ObjectCache objectCache{ObjectCache::budgetFromEnvironment("MINIGIT_OBJECT_CACHE", OBJECT_CACHE_BUDGET)};
+    // Built over every local and alternate object once a command has made
+    // OBJECT_FILTER_THRESHOLD existence checks, then kept up to date by writes.
+    ObjectFilter objectFilter;
+    bool objectFilterBuilt = false;
+    size_t existenceChecks = 0;
+    std::mutex objectFilterLock;
+    bool mightHaveObject(const std::string& hash);
+    void noteObjectWritten(const std::string& hash);
+    void invalidateObjectFilter();
+    ReadAhead readAhead;
+    std::vector<std::string> planReads(const std::vector<std::string>& hashes);
+    void loadPacks();
+    std::string readObject(const std::string& hash);
+    std::string readStoredObject(const std::string& hash);
+    bool hasObject(const std::string& hash);
+    bool hasLocalObject(const std::string& hash);
+    std::mutex promisorLock; // Serializes lazy fetches, which may come from worker threads
+    std::string promisorPath();
+    std::string readPromisedObject(const std::string& hash);
+    void prefetchObjects(const std::vector<std::string>& hashes);
+    bool openObject(const std::string& hash, ObjectStream& stream);
+    bool writeObject(const std::string& hash, const std::string& content);
+    std::string installPack(PackWriter& writer, const std::string& tmpPath, const std::string& packDir = PACK_DIR);
+    bool addToMultiPackIndex(const PackIndex& index);
+    bool installMultiPackIndex(const std::vector<std::string>& names, const std::vector<MultiPackIndex::Record>& records);
+
+    // Caches of parsed repository state. Commits are immutable, so the commit
+    // cache is never invalidated; it is only enabled for long-lived processes
+    // (see setPersistent). File-backed caches are revalidated by FileSignature.
+    bool persistent = false;
+    bool deferWrites = false; // Batch mode: keep index/ref writes in memory until flushed
+    std::map<std::string, std::string> pendingWrites;
+    bool isDeferrable(const std::string& path) const;
+    std::unordered_map<std::string, Commit> commitCache;
+    std::map<std::string, std::string> stagingCache;
+    FileSignature stagingSignature;
+    CommitGraph graphCache;
+    FileSignature graphSignature;
+    BitmapIndex bitmapCache;
+    FileSignature bitmapSignature;
+    FileSignature packDirSignature;
+    FileSignature objectsDirSignature;
+    FileSignature alternatesSignature;
+    FileSignature shallowSignature;
+    bool cacheValid(const std::string& path, FileSignature& cached);
+    const CommitGraph& loadCommitGraph();
+
+    // Shallow repositories: parents of these commits are treated as absent by
+    // readCommit and the commit-graph, so every traversal stops there.
+    std::unordered_set<std::string> shallowCommits;
+    bool shallowLoaded = false;
+    bool isShallow(const std::string& hash);
+    bool writeShallow(const std::unordered_set<std::string>& commits);
 
     // Helper methods for MiniGit logic
     std::map<std::string, std::string> readStagingArea();
@@ -36,67 +204,148 @@ private:
     std::string getFileContentFromCommit(const Commit& commit, const std::string& filename);
     std::string findLCA(const std::string& commitHash1, const std::string& commitHash2);
     void writeBlob(const std::string& content, const std::string& blobHash);
+    std::vector<std::string> changedPaths(const Commit& commit, const Commit& parent);
+    bool touchesPaths(const std::vector<std::string>& changed, const std::vector<std::string>& paths);
+    std::map<std::string, std::string> listBranches();
+    std::map<std::string, std::string> listRemoteRefs();
+    std::vector<std::string> getRefTips();
+    std::string resolveRevision(const std::string& rev);
+    bool listRevisions(const std::vector<std::string>& args, std::vector<std::string>& commits);
+    bool diffContents(const std::string& a, const std::string& b);
+    const BitmapIndex& loadBitmapIndex();
+    std::string remotePath(const std::string& name);
+    bool populateClone(RemoteRepository& remote, const std::string& sourcePath, bool shared, bool blobless, size_t depth);
+    void markReachable(const BitmapIndex& index, const std::string& tip, Reachability& reach,
+                       const std::map<std::string, Commit>* loaded = nullptr);
 
 public:
+    void setPersistent(bool enabled); // Keep caches across commands (daemon/batch mode)
+    ObjectCache::Stats objectCacheStats() { return objectCache.stats(); }
+    void revalidateCaches(); // Drop caches invalidated by other processes
+    void setDeferredWrites(bool enabled); // Hold index and ref writes until flushPendingWrites()
+    bool flushPendingWrites();
 
     bool initRepo(); // Corresponds to 'init'
     bool addFile(const std::string& filename); // Corresponds to 'add'
     bool makeCommit(const std::string& msg); // Corresponds to 'commit'
-    void showLog(); // Corresponds to 'log'
+    void showLog(const LogOptions& options = LogOptions()); // Corresponds to 'log'
     bool createBranch(const std::string& name); // Corresponds to 'branch'
     bool switchTo(const std::string& target); // Corresponds to 'checkout'
     bool mergeBranch(const std::string& name); // Corresponds to 'merge'
     void diffFiles(const std::string& f1, const std::string& f2); // Corresponds to 'diff'
+    bool diffRevisions(const std::vector<std::string>& args); // Corresponds to 'diff <rev> <rev>' / 'diff A..B'
+    bool writeCommitGraph(); // Corresponds to 'commit-graph write'
+    bool writeBitmaps(); // Corresponds to 'bitmap write'
+    bool writeMultiPackIndex(bool quiet = false); // Corresponds to 'multi-pack-index write'
+    bool isAncestor(const std::string& ancestor, const std::string& descendant); // Corresponds to 'is-ancestor'
+    bool revList(const std::vector<std::string>& args, bool countOnly); // Corresponds to 'rev-list [--count]'
+    bool collectGarbage(long long pruneAgeSeconds = GC_DEFAULT_PRUNE_AGE); // Corresponds to 'gc'
+    bool checkIntegrity(); // Corresponds to 'fsck'
+    bool fastImport(std::istream& in); // Corresponds to 'fast-import'
+    bool fastExport(const std::vector<std::string>& branches); // Corresponds to 'fast-export'
+    bool archive(const std::string& rev, const std::string& prefix, bool gzip); // Corresponds to 'archive'
+    bool cloneRepository(const std::string& source, const std::string& directory, bool shared, bool blobless,
+                         size_t depth); // Corresponds to 'clone [--shared] [--filter=blob:none] [--depth=<n>]'
+    bool fetch(const std::string& remote, long deepen = 0); // Corresponds to 'fetch [--deepen=<n>|--unshallow]'
+    bool push(const std::string& remote, const std::vector<std::string>& branches, bool force); // Corresponds to 'push'
+    bool createBundle(const std::string& file, const std::vector<std::string>& revisions); // Corresponds to 'bundle create'
+    bool verifyBundle(const std::string& file); // Corresponds to 'bundle verify'
+    bool unbundle(const std::string& file); // Corresponds to 'bundle unbundle'
 };
 
+// Directories are only ever created, never removed while a command runs, so
+// each one is checked once.
 bool MiniGit::createDirectory(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> guard(knownDirectoriesLock);
+        if (knownDirectories.count(path)) return true;
+    }
     std::error_code ec;
+    PerfCounters::bump(perfCounters.filesStatted);
     if (!fs::exists(path, ec)) {
-        if (fs::create_directories(path, ec)) {
-            return true;
-        } else {
+        if (!fs::create_directories(path, ec)) {
             std::cerr << "Error creating directory '" << path << "': " << ec.message() << std::endl;
             return false;
         }
+    } else if (!fs::is_directory(path, ec)) {
+        std::cerr << "Error: Path '" << path << "' exists but is not a directory." << std::endl;
+        return false;
     }
-    if (fs::is_directory(path, ec)) {
-        return true;
-    }
-    std::cerr << "Error: Path '" << path << "' exists but is not a directory." << std::endl;
-    return false;
+    std::lock_guard<std::mutex> guard(knownDirectoriesLock);
+    knownDirectories.insert(path);
+    return true;
 }
 
 bool MiniGit::fileExists(const std::string& path) {
+    if (!pendingWrites.empty() && pendingWrites.count(path)) return true;
+    PerfCounters::bump(perfCounters.filesStatted);
     return fs::exists(path);
 }
 
+// Returns "" for a missing file; use the two-argument form where that must
+// be told apart from an empty one.
 std::string MiniGit::readFile(const std::string& path) {
-    std::ifstream file(path, std::ios::binary);
-    if (!file.is_open()) {
-        return "";
-    }
-    std::string content((std::istreambuf_iterator<char>(file)),
-                         std::istreambuf_iterator<char>());
-    file.close();
+    std::string content;
+    readFile(path, content);
     return content;
 }
 
+// False if the file doesn't exist (quietly) or can't be read (with an error).
+bool MiniGit::readFile(const std::string& path, std::string& content) {
+    if (!pendingWrites.empty()) {
+        auto it = pendingWrites.find(path);
+        if (it != pendingWrites.end()) {
+            content = it->second;
+            return true;
+        }
+    }
+    TraceSpan span("readFile", "io", path);
+    int error = FileIO::read(path, content);
+    if (error == 0) return true;
+    if (error != ENOENT && error != ENOTDIR) {
+        std::cerr << "Error: Could not read file " << path << ": " << FileIO::message(error) << std::endl;
+    }
+    return false;
+}
+
 bool MiniGit::writeFile(const std::string& path, const std::string& content) {
-    fs::path p = path;
-    if (p.has_parent_path()) {
-        if (!createDirectory(p.parent_path().string())) {
-            std::cerr << "Error: Could not create parent directory for writing file: " << path << std::endl;
-            return false;
+    if (path == INDEX_FILE) stagingSignature = FileSignature(); // Cached staging area is stale
+    if (deferWrites && isDeferrable(path)) {
+        pendingWrites[path] = content;
+        return true;
+    }
+
+    size_t slash = path.rfind('/');
+    if (slash != std::string::npos && slash > 0 && !createDirectory(path.substr(0, slash))) {
+        std::cerr << "Error: Could not create parent directory for writing file: " << path << std::endl;
+        return false;
+    }
+
+    TraceSpan span("writeFile", "io", path);
+    int error = FileIO::write(path, content);
+    if (error == ENOENT && slash != std::string::npos && slash > 0) {
+        // The parent was removed since createDirectory saw it (e.g. by the
+        // user, between two daemon commands): forget it, recreate it, retry once.
+        std::string parent = path.substr(0, slash);
+        {
+            std::lock_guard<std::mutex> guard(knownDirectoriesLock);
+            knownDirectories.erase(parent);
         }
+        if (createDirectory(parent)) error = FileIO::write(path, content);
     }
+    if (error != 0) {
+        std::cerr << "Error: Could not write file " << path << ": " << FileIO::message(error) << std::endl;
+        return false;
+    }
+    return true;
+}
 
-    std::ofstream file(path, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open file for writing: " << path << std::endl;
+bool MiniGit::appendFile(const std::string& path, const std::string& content) {
+    int error = FileIO::write(path, content, true);
+    if (error != 0) {
+        std::cerr << "Error: Could not append to file " << path << ": " << FileIO::message(error) << std::endl;
         return false;
     }
-    file << content;
-    file.close();
     return true;
 }
 
@@ -114,6 +363,9 @@ bool MiniGit::removeFile(const std::string& path) {
 }
 
 std::map<std::string, std::string> MiniGit::readStagingArea() {
+    if (persistent && cacheValid(INDEX_FILE, stagingSignature)) return stagingCache;
+    TraceSpan span("readStagingArea", "index");
+    PerfCounters::bump(perfCounters.indexReads);
     std::map<std::string, std::string> stagingArea;
     std::string content = readFile(INDEX_FILE);
     std::stringstream ss(content);
@@ -126,15 +378,23 @@ std::map<std::string, std::string> MiniGit::readStagingArea() {
             stagingArea[filePath] = blobHash;
         }
     }
+    if (persistent) stagingCache = stagingArea;
     return stagingArea;
 }
 
 bool MiniGit::writeStagingArea(const std::map<std::string, std::string>& stagingArea) {
+    TraceSpan span("writeStagingArea", "index");
+    PerfCounters::bump(perfCounters.indexWrites);
     std::stringstream ss;
     for (const auto& entry : stagingArea) {
         ss << entry.first << " " << entry.second << "\n";
     }
-    return writeFile(INDEX_FILE, ss.str());
+    if (!writeFile(INDEX_FILE, ss.str())) return false;
+    if (persistent) {
+        stagingCache = stagingArea;
+        cacheValid(INDEX_FILE, stagingSignature); // Record the signature of what we just wrote
+    }
+    return true;
 }
 
 std::string MiniGit::getHeadCommitHash() {
@@ -164,6 +424,7 @@ std::string MiniGit::getHeadCommitHash() {
 }
 
 bool MiniGit::updateHead(const std::string& commitHash) {
+    TraceSpan span("updateHead", "ref", commitHash);
     std::string headContent = readFile(HEAD_FILE);
     if (headContent.rfind("ref: ", 0) == 0) {
         std::string refPath = headContent.substr(5);
@@ -177,24 +438,538 @@ bool MiniGit::updateHead(const std::string& commitHash) {
     }
 }
 
+void MiniGit::setPersistent(bool enabled) {
+    persistent = enabled;
+    if (!enabled) commitCache.clear();
+}
+
+// Only the staging area and refs are deferred; objects are content-addressed
+// and must exist before anything refers to them, and working files are the
+// user's.
+bool MiniGit::isDeferrable(const std::string& path) const {
+    return path == INDEX_FILE || path.rfind(REFS_DIR, 0) == 0;
+}
+
+void MiniGit::setDeferredWrites(bool enabled) {
+    deferWrites = enabled;
+}
+
+// Writes out everything held back by setDeferredWrites(true).
+bool MiniGit::flushPendingWrites() {
+    std::map<std::string, std::string> pending;
+    pending.swap(pendingWrites);
+    bool deferred = deferWrites;
+    deferWrites = false;
+    bool ok = true;
+    for (const auto& entry : pending) {
+        ok = writeFile(entry.first, entry.second) && ok;
+    }
+    deferWrites = deferred;
+    return ok;
+}
+
+// Called before each command of a long-lived process.
+void MiniGit::revalidateCaches() {
+    {
+        std::lock_guard<std::mutex> guard(knownDirectoriesLock);
+        knownDirectories.clear(); // Directories may have been removed between commands
+    }
+    if (!cacheValid(PACK_DIR, packDirSignature)) packsLoaded = false;
+    if (!cacheValid(ALTERNATES_FILE, alternatesSignature)) packsLoaded = false;
+    bool looseChanged = !cacheValid(OBJECTS_DIR, objectsDirSignature);
+    if (!packsLoaded || looseChanged) invalidateObjectFilter(); // Objects may have been added behind its back
+    if (!cacheValid(SHALLOW_FILE, shallowSignature)) {
+        shallowLoaded = false;
+        commitCache.clear();
+        graphSignature = FileSignature();
+    }
+}
+
+// True if `path` is unchanged since `cached` was recorded; records the current signature.
+bool MiniGit::cacheValid(const std::string& path, FileSignature& cached) {
+    FileSignature current = FileSignature::of(path);
+    bool valid = !cached.racy && cached.sameFile(current);
+    cached = current;
+    return valid;
+}
+
+const CommitGraph& MiniGit::loadCommitGraph() {
+    if (!cacheValid(COMMIT_GRAPH_FILE, graphSignature)) {
+        graphCache = graphSignature.exists ? CommitGraph::deserialize(readFile(COMMIT_GRAPH_FILE)) : CommitGraph();
+        isShallow("");
+        for (const std::string& hash : shallowCommits) {
+            auto it = graphCache.entries.find(hash);
+            if (it != graphCache.entries.end()) it->second.parentHash.clear();
+        }
+    }
+    return graphCache;
+}
+
+// Pack indexes in `packDir`, except for the packs named in `skip`.
+static std::vector<PackIndex> loadPackIndexes(const std::string& packDir, const std::set<std::string>& skip = {}) {
+    std::vector<PackIndex> indexes;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(packDir, ec)) {
+        std::string path = entry.path().string();
+        if (entry.path().extension() != ".idx") continue;
+        if (skip.count(entry.path().stem().string() + ".pack")) continue;
+        std::string data;
+        FileIO::read(path, data);
+        indexes.push_back(PackIndex::deserialize(data, path.substr(0, path.size() - 4) + ".pack"));
+    }
+    return indexes;
+}
+
+// Loads the pack indexes of this repository and of its alternates. Packs the
+// multi-pack index covers are found through it alone, so their own indexes
+// aren't read. ALTERNATES_FILE lists one objects directory per line, absolute
+// or relative to OBJECTS_DIR; blank lines and '#' comments are ignored.
+void MiniGit::loadPacks() {
+    packsLoaded = true;
+    std::set<std::string> covered;
+    if (multiPackIndex.open(MULTI_PACK_INDEX_FILE, PACK_DIR)) {
+        covered.insert(multiPackIndex.packs().begin(), multiPackIndex.packs().end());
+        for (const std::string& name : covered) {
+            if (fileExists(PACK_DIR + name)) continue;
+            multiPackIndex.close(); // A covered pack was removed; the index is stale
+            covered.clear();
+            break;
+        }
+    }
+    packs = loadPackIndexes(PACK_DIR, covered);
+    alternates.clear();
+    std::stringstream list(readFile(ALTERNATES_FILE));
+    std::string line;
+    while (std::getline(list, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        AlternateStore store;
+        store.objectsDir = fs::path(line).is_absolute() ? line : OBJECTS_DIR + line;
+        if (store.objectsDir.back() != '/') store.objectsDir += '/';
+        store.packs = loadPackIndexes(store.objectsDir + "pack/");
+        alternates.push_back(std::move(store));
+    }
+}
+
+// Every object read goes through here, and through the object cache. Only
+// streamed reads (openObject) and fsck's hash check of the stored bytes bypass it.
+std::string MiniGit::readObject(const std::string& hash) {
+    std::string content;
+    if (objectCache.get(hash, content)) return content;
+    content = readStoredObject(hash);
+    if (!content.empty()) {
+        PerfCounters::bump(perfCounters.objectsRead);
+        objectCache.put(hash, content);
+    }
+    return content;
+}
+
+// Reads an object from disk: the loose object if present, otherwise the packs,
+// otherwise the alternates in the order they are listed, and in a partial
+// clone finally the promisor repository.
+std::string MiniGit::readStoredObject(const std::string& hash) {
+    TraceSpan span("readObject", "object", hash);
+    if (!mightHaveObject(hash)) return readPromisedObject(hash);
+    std::string content = readFile(OBJECTS_DIR + hash);
+    if (!content.empty()) return content;
+    if (!packsLoaded) loadPacks();
+    const std::string* packPath;
+    unsigned long long offset, length;
+    if (multiPackIndex.find(hash, packPath, offset, length)) {
+        PackIndex::Entry entry{hash, offset, length};
+        PackIndex pack;
+        pack.packPath = *packPath;
+        pack.read(entry, content);
+        return content;
+    }
+    for (const PackIndex& pack : packs) {
+        if (const PackIndex::Entry* entry = pack.find(hash)) {
+            pack.read(*entry, content);
+            return content;
+        }
+    }
+    for (const AlternateStore& store : alternates) {
+        content = readFile(store.objectsDir + hash);
+        if (!content.empty()) return content;
+        for (const PackIndex& pack : store.packs) {
+            if (const PackIndex::Entry* entry = pack.find(hash)) {
+                pack.read(*entry, content);
+                return content;
+            }
+        }
+    }
+    return readPromisedObject(hash);
+}
+
+bool MiniGit::hasObject(const std::string& hash) {
+    if (hash.empty() || hash.find('/') != std::string::npos || !mightHaveObject(hash)) return false;
+    if (hasLocalObject(hash)) return true;
+    for (const AlternateStore& store : alternates) {
+        std::error_code ec;
+        PerfCounters::bump(perfCounters.filesStatted);
+        if (fs::exists(store.objectsDir + hash, ec)) return true;
+        for (const PackIndex& pack : store.packs) {
+            if (pack.find(hash)) return true;
+        }
+    }
+    return false;
+}
+
+// True if the object is stored in this repository itself, not only in an alternate.
+bool MiniGit::hasLocalObject(const std::string& hash) {
+    if (hash.empty() || hash.find('/') != std::string::npos || !mightHaveObject(hash)) return false;
+    if (fileExists(OBJECTS_DIR + hash)) return true;
+    if (!packsLoaded) loadPacks();
+    const std::string* packPath;
+    unsigned long long offset, length;
+    if (multiPackIndex.find(hash, packPath, offset, length)) return true;
+    for (const PackIndex& pack : packs) {
+        if (pack.find(hash)) return true;
+    }
+    return false;
+}
+
+// Like readObject, but leaves the bytes on disk for the caller to stream.
+bool MiniGit::openObject(const std::string& hash, ObjectStream& stream) {
+    if (hash.empty() || hash.find('/') != std::string::npos) return false;
+    std::error_code ec;
+    std::uintmax_t looseSize = fs::file_size(OBJECTS_DIR + hash, ec);
+    if (!ec) return stream.open(OBJECTS_DIR + hash, 0, looseSize);
+    if (!packsLoaded) loadPacks();
+    const std::string* packPath;
+    unsigned long long offset, length;
+    if (multiPackIndex.find(hash, packPath, offset, length)) return stream.open(*packPath, offset, length);
+    for (const PackIndex& pack : packs) {
+        if (const PackIndex::Entry* entry = pack.find(hash)) return stream.open(pack.packPath, entry->offset, entry->length);
+    }
+    for (const AlternateStore& store : alternates) {
+        looseSize = fs::file_size(store.objectsDir + hash, ec);
+        if (!ec) return stream.open(store.objectsDir + hash, 0, looseSize);
+        for (const PackIndex& pack : store.packs) {
+            if (const PackIndex::Entry* entry = pack.find(hash)) return stream.open(pack.packPath, entry->offset, entry->length);
+        }
+    }
+    if (!readPromisedObject(hash).empty() || fileExists(OBJECTS_DIR + hash)) {
+        looseSize = fs::file_size(OBJECTS_DIR + hash, ec);
+        if (!ec) return stream.open(OBJECTS_DIR + hash, 0, looseSize);
+    }
+    return false;
+}
+
+// Orders object reads the way the objects lie on disk (packed ones by pack
+// and offset, loose ones by inode, which most filesystems allocate in
+// creation order) and passes the ranges to the read-ahead thread, so the
+// reads that follow mostly hit the page cache. Returns each hash once;
+// objects only found in alternates or the promisor come last.
+std::vector<std::string> MiniGit::planReads(const std::vector<std::string>& hashes) {
+    TraceSpan span("planReads", "object");
+    struct Planned {
+        const std::string* hash;
+        const std::string* pack; // nullptr for a loose object
+        unsigned long long position; // Offset in the pack, or the loose file's inode
+        unsigned long long length;
+    };
+    if (!packsLoaded) loadPacks();
+    std::vector<Planned> planned;
+    std::vector<std::string> elsewhere;
+    std::unordered_set<std::string> seen;
+    for (const std::string& hash : hashes) {
+        if (!seen.insert(hash).second) continue;
+        if (hash.empty() || hash.find('/') != std::string::npos) {
+            elsewhere.push_back(hash);
+            continue;
+        }
+        const std::string* packPath;
+        unsigned long long offset, length;
+        if (multiPackIndex.find(hash, packPath, offset, length)) {
+            planned.push_back({&hash, packPath, offset, length});
+            continue;
+        }
+        const PackIndex::Entry* entry = nullptr;
+        for (const PackIndex& pack : packs) {
+            if ((entry = pack.find(hash))) {
+                planned.push_back({&hash, &pack.packPath, entry->offset, entry->length});
+                break;
+            }
+        }
+        if (entry) continue;
+        struct stat st;
+        if (::stat((OBJECTS_DIR + hash).c_str(), &st) == 0) {
+            planned.push_back({&hash, nullptr, static_cast<unsigned long long>(st.st_ino), 0});
+        } else {
+            elsewhere.push_back(hash);
+        }
+    }
+    std::sort(planned.begin(), planned.end(), [](const Planned& a, const Planned& b) {
+        if (a.pack != b.pack) return !a.pack || (b.pack && *a.pack < *b.pack);
+        return a.position < b.position;
+    });
+
+    std::vector<ReadAhead::Range> ranges;
+    std::vector<std::string> order;
+    ranges.reserve(planned.size());
+    order.reserve(planned.size() + elsewhere.size());
+    for (const Planned& object : planned) {
+        if (object.pack) ranges.push_back({*object.pack, object.position, object.length});
+        else ranges.push_back({OBJECTS_DIR + *object.hash, 0, 0});
+        order.push_back(*object.hash);
+    }
+    readAhead.hint(ranges);
+    order.insert(order.end(), elsewhere.begin(), elsewhere.end());
+    return order;
+}
+
+// Partial clones (clone --filter=blob:none) start without blobs. The path of
+// the repository that promised them is kept in PROMISOR_FILE; "" otherwise.
+std::string MiniGit::promisorPath() {
+    std::string path = readFile(PROMISOR_FILE);
+    if (!path.empty() && path.back() == '\n') path.pop_back();
+    return path;
+}
+
+// Lazily fetches one missing object from the promisor and stores it as a
+// loose object. Returns its content, or "" if there is no promisor or it
+// doesn't have the object either.
+std::string MiniGit::readPromisedObject(const std::string& hash) {
+    if (hash.empty() || hash.find('/') != std::string::npos || !fileExists(PROMISOR_FILE)) return "";
+    std::lock_guard<std::mutex> guard(promisorLock);
+    std::string content = readFile(OBJECTS_DIR + hash); // Another thread may have just fetched it
+    if (!content.empty()) return content;
+    RemoteRepository promisor(promisorPath());
+    content = promisor.readObject(hash);
+    if (computeSimpleHash(content) != hash) return "";
+    writeObject(hash, content);
+    return content;
+}
+
+// Fetches, as one pack, every object in `hashes` that a partial clone is
+// still missing, so a checkout or merge doesn't fetch its blobs one by one.
+void MiniGit::prefetchObjects(const std::vector<std::string>& hashes) {
+    if (!fileExists(PROMISOR_FILE)) return;
+    std::vector<std::string> missing;
+    std::unordered_set<std::string> seen;
+    for (const std::string& hash : hashes) {
+        if (seen.insert(hash).second && !hasObject(hash)) missing.push_back(hash);
+    }
+    if (missing.empty()) return;
+
+    std::lock_guard<std::mutex> guard(promisorLock);
+    RemoteRepository promisor(promisorPath());
+    if (!createDirectory(PACK_DIR)) return;
+    std::string tmpPath = PACK_DIR + "tmp-promised-" + std::to_string(::getpid());
+    PackWriter writer(tmpPath);
+    if (!writer.isOpen()) return;
+    for (const std::string& hash : missing) {
+        std::string content = promisor.readObject(hash);
+        if (computeSimpleHash(content) == hash) writer.add(hash, content);
+    }
+    if (writer.objectCount() > 0) {
+        installPack(writer, tmpPath);
+    } else {
+        writer.finish();
+        removeFile(tmpPath);
+    }
+}
+
+// Objects are immutable, so an existing file is never rewritten; clones may
+// share it through a hardlink.
+bool MiniGit::writeObject(const std::string& hash, const std::string& content) {
+    TraceSpan span("writeObject", "object", hash);
+    if (mightHaveObject(hash) && fileExists(OBJECTS_DIR + hash)) return true;
+    if (!writeFile(OBJECTS_DIR + hash, content)) return false;
+    PerfCounters::bump(perfCounters.objectsWritten);
+    noteObjectWritten(hash);
+    return true;
+}
+
+// False only if the object is definitely not stored locally or in an
+// alternate. Until the filter is built this is always true; building it
+// means listing every object, so it waits until a command has made enough
+// existence checks to pay for that.
+bool MiniGit::mightHaveObject(const std::string& hash) {
+    std::lock_guard<std::mutex> guard(objectFilterLock);
+    if (!objectFilterBuilt) {
+        if (++existenceChecks < OBJECT_FILTER_THRESHOLD) return true;
+        if (!packsLoaded) loadPacks();
+        std::vector<std::string> hashes;
+        std::error_code ec;
+        auto addLoose = [&](const std::string& dir) {
+            for (const auto& entry : fs::directory_iterator(dir, ec)) {
+                if (entry.is_regular_file(ec)) hashes.push_back(entry.path().filename().string());
+            }
+        };
+        addLoose(OBJECTS_DIR);
+        for (size_t i = 0; i < multiPackIndex.objectCount(); ++i) hashes.push_back(multiPackIndex.hashAt(i));
+        std::vector<const PackIndex*> indexes;
+        for (const PackIndex& pack : packs) indexes.push_back(&pack);
+        for (const AlternateStore& store : alternates) {
+            addLoose(store.objectsDir);
+            for (const PackIndex& pack : store.packs) indexes.push_back(&pack);
+        }
+        for (const PackIndex* pack : indexes) {
+            for (const PackIndex::Entry& entry : pack->all()) hashes.push_back(entry.hash);
+        }
+        objectFilter.reset(hashes.size());
+        for (const std::string& hash : hashes) objectFilter.add(hash);
+        objectFilterBuilt = true;
+    }
+    return objectFilter.mightContain(hash);
+}
+
+void MiniGit::noteObjectWritten(const std::string& hash) {
+    std::lock_guard<std::mutex> guard(objectFilterLock);
+    if (!objectFilterBuilt) return;
+    objectFilter.add(hash);
+    if (objectFilter.full()) objectFilterBuilt = false; // Rebuilt larger at the next check
+}
+
+// Objects were added without going through writeObject or installPack.
+void MiniGit::invalidateObjectFilter() {
+    std::lock_guard<std::mutex> guard(objectFilterLock);
+    objectFilterBuilt = false;
+    existenceChecks = 0;
+}
+
+// Finishes a pack written to `tmpPath`, names it after its contents and
+// moves it into `packDir` (another repository's, for push) with its index. Returns the pack path, or "" on error;
+// a pack that wasn't written completely is removed, never installed.
+std::string MiniGit::installPack(PackWriter& writer, const std::string& tmpPath, const std::string& packDir) {
+    TraceSpan span("installPack", "object", tmpPath);
+    PackIndex index = writer.finish();
+    if (!writer.complete()) {
+        std::cerr << "Error: Could not write pack file " << tmpPath << "." << std::endl;
+        removeFile(tmpPath);
+        return "";
+    }
+    std::string allHashes;
+    for (const PackIndex::Entry& entry : index.all()) allHashes += entry.hash;
+    std::string base = packDir + "pack-" + computeSimpleHash(allHashes);
+
+    std::error_code ec;
+    fs::rename(tmpPath, base + ".pack", ec);
+    index.packPath = base + ".pack";
+    if (ec || !writeFile(base + ".idx", index.serialize())) {
+        std::cerr << "Error: Could not install pack file " << base << ".pack: " << ec.message() << std::endl;
+        removeFile(tmpPath);
+        return "";
+    }
+    PerfCounters::bump(perfCounters.objectsWritten, index.all().size());
+    if (packDir == PACK_DIR) {
+        if (fileExists(MULTI_PACK_INDEX_FILE)) addToMultiPackIndex(index);
+        for (const PackIndex::Entry& entry : index.all()) noteObjectWritten(entry.hash);
+    }
+    packsLoaded = false; // Pick up the new pack on the next read
+    return base + ".pack";
+}
+
+// Merges a newly installed pack into the existing multi-pack index: both are
+// sorted by hash, so this is one linear pass instead of a rebuild from every
+// pack index. Objects already indexed keep their old location.
+bool MiniGit::addToMultiPackIndex(const PackIndex& index) {
+    MultiPackIndex current;
+    if (!current.open(MULTI_PACK_INDEX_FILE, PACK_DIR)) return writeMultiPackIndex(true);
+    std::vector<std::string> names = current.packs();
+    std::string name = fs::path(index.packPath).filename().string();
+    if (std::find(names.begin(), names.end(), name) != names.end()) return true;
+    names.push_back(name);
+
+    std::vector<MultiPackIndex::Record> existing = current.records();
+    std::vector<MultiPackIndex::Record> added;
+    added.reserve(index.all().size());
+    unsigned packId = static_cast<unsigned>(names.size() - 1);
+    for (const PackIndex::Entry& entry : index.all()) added.push_back({entry.hash, packId, entry.offset, entry.length});
+    std::vector<MultiPackIndex::Record> merged;
+    merged.reserve(existing.size() + added.size());
+    std::merge(existing.begin(), existing.end(), added.begin(), added.end(), std::back_inserter(merged),
+               MultiPackIndex::byHash);
+    current.close();
+    return installMultiPackIndex(names, merged);
+}
+
+// Writes the index under a temporary name and renames it into place, since
+// other processes may have the old one mapped. An index that can't be
+// written is removed rather than left stale.
+bool MiniGit::installMultiPackIndex(const std::vector<std::string>& names,
+                                    const std::vector<MultiPackIndex::Record>& records) {
+    std::string data = MultiPackIndex::serialize(names, records);
+    std::string tmpPath = MULTI_PACK_INDEX_FILE + ".lock";
+    std::error_code ec;
+    if (data.empty() || names.size() > 0xffff || !writeFile(tmpPath, data)) {
+        removeFile(tmpPath);
+        removeFile(MULTI_PACK_INDEX_FILE);
+        std::cerr << "Error: Could not write multi-pack index." << std::endl;
+        return false;
+    }
+    fs::rename(tmpPath, MULTI_PACK_INDEX_FILE, ec);
+    if (ec) {
+        std::cerr << "Error: Could not install multi-pack index: " << ec.message() << std::endl;
+        removeFile(tmpPath);
+        return false;
+    }
+    packsLoaded = false;
+    return true;
+}
+
 Commit MiniGit::readCommit(const std::string& commitHash) {
-    std::string commitPath = OBJECTS_DIR + commitHash;
-    std::string commitData = readFile(commitPath);
+    if (persistent) {
+        auto it = commitCache.find(commitHash);
+        if (it != commitCache.end()) return it->second;
+    }
+    std::string commitData = readObject(commitHash);
     if (commitData.empty()) {
         return Commit();
     }
-    return Commit::deserialize(commitData);
+    Commit commit = Commit::deserialize(commitData);
+    if (isShallow(commitHash)) commit.parentHash.clear();
+    if (persistent) commitCache.emplace(commitHash, commit);
+    return commit;
+}
+
+bool MiniGit::isShallow(const std::string& hash) {
+    if (!shallowLoaded) {
+        shallowLoaded = true;
+        shallowCommits.clear();
+        std::stringstream list(readFile(SHALLOW_FILE));
+        std::string line;
+        while (std::getline(list, line)) {
+            if (!line.empty()) shallowCommits.insert(line);
+        }
+    }
+    return !shallowCommits.empty() && shallowCommits.count(hash) > 0;
+}
+
+// Replaces the shallow list (removing the file once the history is complete).
+// Cached parents are dropped; a commit-graph or bitmaps written while the
+// history was shorter no longer describe it, so they are removed too.
+bool MiniGit::writeShallow(const std::unordered_set<std::string>& commits) {
+    bool deepened = false;
+    isShallow("");
+    for (const std::string& hash : shallowCommits) deepened = deepened || !commits.count(hash);
+    std::vector<std::string> sorted(commits.begin(), commits.end());
+    std::sort(sorted.begin(), sorted.end());
+    std::string content;
+    for (const std::string& hash : sorted) content += hash + "\n";
+    if (!(sorted.empty() ? removeFile(SHALLOW_FILE) : writeFile(SHALLOW_FILE, content))) return false;
+    shallowCommits = commits;
+    commitCache.clear();
+    if (deepened) {
+        removeFile(COMMIT_GRAPH_FILE);
+        removeFile(BITMAPS_FILE);
+    }
+    graphSignature = FileSignature();
+    bitmapSignature = FileSignature();
+    return true;
 }
 
 std::string MiniGit::getFileContentFromCommit(const Commit& commit, const std::string& filename) {
     auto it = commit.fileBlobs.find(filename);
     if (it != commit.fileBlobs.end()) {
-        return readFile(OBJECTS_DIR + it->second);
+        return readObject(it->second);
     }
     return "";
 }
 
 std::string MiniGit::findLCA(const std::string& commitHash1, const std::string& commitHash2) {
+    TraceSpan span("findLCA", "history");
     std::set<std::string> path1;
     std::string current = commitHash1;
     while (!current.empty()) {
@@ -215,7 +990,242 @@ std::string MiniGit::findLCA(const std::string& commitHash1, const std::string&
 }
 
 void MiniGit::writeBlob(const std::string& content, const std::string& blobHash) {
-    writeFile(OBJECTS_DIR + blobHash, content);
+    writeObject(blobHash, content);
+}
+
+// Parses a size or count read from a file or stream: digits only, no sign,
+// no trailing text, and within range. False for anything else.
+static bool parseDecimal(const std::string& text, unsigned long long& value) {
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) return false;
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtoull(text.c_str(), &end, 10);
+    return *end == '\0' && errno != ERANGE;
+}
+
+// Paths are stored as given to 'add' ("a.txt" or "./a.txt"); compare them without the "./".
+static std::string normalizePath(const std::string& path) {
+    std::string p = path;
+    while (p.rfind("./", 0) == 0) p = p.substr(2);
+    while (p.size() > 1 && p.back() == '/') p.pop_back();
+    return p;
+}
+
+std::vector<std::string> MiniGit::changedPaths(const Commit& commit, const Commit& parent) {
+    std::vector<std::string> changed;
+    for (const auto& entry : commit.fileBlobs) {
+        auto it = parent.fileBlobs.find(entry.first);
+        if (it == parent.fileBlobs.end() || it->second != entry.second) {
+            changed.push_back(normalizePath(entry.first));
+        }
+    }
+    for (const auto& entry : parent.fileBlobs) {
+        if (!commit.fileBlobs.count(entry.first)) {
+            changed.push_back(normalizePath(entry.first));
+        }
+    }
+    return changed;
+}
+
+bool MiniGit::touchesPaths(const std::vector<std::string>& changed, const std::vector<std::string>& paths) {
+    for (const std::string& path : paths) {
+        for (const std::string& file : changed) {
+            if (file == path || (file.size() > path.size() && file.rfind(path, 0) == 0 && file[path.size()] == '/')) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Branch names and the commits they point to (empty for a branch without commits).
+std::map<std::string, std::string> MiniGit::listBranches() {
+    std::map<std::string, std::string> branches;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(HEADS_DIR, ec)) {
+        if (!entry.is_regular_file(ec)) continue;
+        branches[entry.path().filename().string()] = "";
+    }
+    for (const auto& pending : pendingWrites) {
+        if (pending.first.rfind(HEADS_DIR, 0) == 0) branches[pending.first.substr(HEADS_DIR.size())] = "";
+    }
+    for (auto& branch : branches) {
+        std::string hash = readFile(HEADS_DIR + branch.first);
+        if (!hash.empty() && hash.back() == '\n') hash.pop_back();
+        branch.second = hash;
+    }
+    return branches;
+}
+
+// Remote-tracking refs ("origin/master") and the commits they point to.
+std::map<std::string, std::string> MiniGit::listRemoteRefs() {
+    std::map<std::string, std::string> refs;
+    std::error_code ec;
+    for (const auto& entry : fs::recursive_directory_iterator(REMOTES_DIR, ec)) {
+        if (!entry.is_regular_file(ec)) continue;
+        refs[fs::relative(entry.path(), REMOTES_DIR, ec).generic_string()] = "";
+    }
+    for (const auto& pending : pendingWrites) {
+        if (pending.first.rfind(REMOTES_DIR, 0) == 0) refs[pending.first.substr(REMOTES_DIR.size())] = "";
+    }
+    for (auto& ref : refs) {
+        std::string hash = readFile(REMOTES_DIR + ref.first);
+        if (!hash.empty() && hash.back() == '\n') hash.pop_back();
+        ref.second = hash;
+    }
+    return refs;
+}
+
+// Commits pointed to by HEAD, every branch and every remote-tracking ref, without duplicates.
+std::vector<std::string> MiniGit::getRefTips() {
+    std::vector<std::string> tips;
+    std::set<std::string> seen;
+    std::string head = getHeadCommitHash();
+    if (!head.empty() && seen.insert(head).second) tips.push_back(head);
+
+    for (const auto& branch : listBranches()) {
+        if (!branch.second.empty() && seen.insert(branch.second).second) tips.push_back(branch.second);
+    }
+    for (const auto& ref : listRemoteRefs()) {
+        if (!ref.second.empty() && seen.insert(ref.second).second) tips.push_back(ref.second);
+    }
+    return tips;
+}
+
+// Resolves a single revision (see Revision.cpp) to a commit hash, or "" if it doesn't name one.
+std::string MiniGit::resolveRevision(const std::string& rev) {
+    std::string base;
+    std::vector<RevisionStep> steps;
+    if (!splitRevisionSuffix(rev, base, steps)) return "";
+
+    std::string hash;
+    if (base == "HEAD") {
+        hash = getHeadCommitHash();
+    } else if (fileExists(HEADS_DIR + base)) {
+        hash = readFile(HEADS_DIR + base);
+        if (!hash.empty() && hash.back() == '\n') hash.pop_back();
+    } else if (base.find('/') != std::string::npos && fileExists(REMOTES_DIR + base)) {
+        hash = readFile(REMOTES_DIR + base);
+        if (!hash.empty() && hash.back() == '\n') hash.pop_back();
+    } else if (hasObject(base)) {
+        hash = base;
+    } else if (base.size() >= 4 && base.find_first_not_of("0123456789abcdef") == std::string::npos) {
+        // Unique abbreviated hash, loose or packed
+        std::set<std::string> matches;
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator(OBJECTS_DIR, ec)) {
+            std::string name = entry.path().filename().string();
+            if (name.rfind(base, 0) == 0) matches.insert(name);
+        }
+        if (!packsLoaded) loadPacks();
+        for (const std::string& match : multiPackIndex.withPrefix(base)) matches.insert(match);
+        std::vector<const PackIndex*> indexes;
+        for (const PackIndex& pack : packs) indexes.push_back(&pack);
+        for (const AlternateStore& store : alternates) {
+            for (const auto& entry : fs::directory_iterator(store.objectsDir, ec)) {
+                std::string name = entry.path().filename().string();
+                if (name.rfind(base, 0) == 0 && entry.is_regular_file(ec)) matches.insert(name);
+            }
+            for (const PackIndex& pack : store.packs) indexes.push_back(&pack);
+        }
+        for (const PackIndex* pack : indexes) {
+            for (const PackIndex::Entry& entry : pack->all()) {
+                if (entry.hash.rfind(base, 0) == 0) matches.insert(entry.hash);
+            }
+        }
+        if (matches.size() != 1) return ""; // Unknown or ambiguous
+        hash = *matches.begin();
+    }
+    if (hash.empty()) return "";
+
+    for (const RevisionStep& step : steps) {
+        if (step.op == '^' && step.count > 1) return ""; // Commits have a single parent
+        for (unsigned long i = 0; i < step.count; ++i) {
+            hash = readCommit(hash).parentHash;
+            if (hash.empty()) return "";
+        }
+    }
+    return hash;
+}
+
+// Expands revision arguments into the commits they select, newest first.
+// All tips are walked together in commit-time order, painting each commit
+// with flag bits, so history shared by the included and excluded sides is
+// visited once and the walk stops as soon as only excluded commits remain.
+bool MiniGit::listRevisions(const std::vector<std::string>& args, std::vector<std::string>& commits) {
+    RevisionRange range;
+    if (!parseRevisionArgs(args, range)) {
+        std::cerr << "Error: Invalid revision arguments." << std::endl;
+        return false;
+    }
+
+    enum : unsigned { LEFT = 1, RIGHT = 2, UNINTERESTING = 4 };
+    struct Node {
+        std::string parentHash;
+        long long time;
+        unsigned flags;
+        unsigned propagated; // Flags already pushed to the parent
+    };
+    std::unordered_map<std::string, Node> nodes;
+    std::set<std::pair<long long, std::string>> queue; // Ordered by time; newest at the end
+
+    auto mark = [&](const std::string& hash, unsigned flags) {
+        auto it = nodes.find(hash);
+        if (it == nodes.end()) {
+            Commit commit = readCommit(hash);
+            it = nodes.emplace(hash, Node{commit.parentHash, commit.time, 0, 0}).first;
+        }
+        Node& node = it->second;
+        node.flags |= flags;
+        if (range.symmetric && (node.flags & LEFT) && (node.flags & RIGHT)) {
+            node.flags |= UNINTERESTING; // Reachable from both sides
+        }
+        if (node.flags != node.propagated) queue.emplace(node.time, hash);
+    };
+
+    for (size_t i = 0; i < range.include.size(); ++i) {
+        std::string hash = resolveRevision(range.include[i]);
+        if (hash.empty()) {
+            std::cerr << "Error: Unknown revision '" << range.include[i] << "'." << std::endl;
+            return false;
+        }
+        mark(hash, range.symmetric && i % 2 == 0 ? LEFT : RIGHT);
+    }
+    for (const std::string& rev : range.exclude) {
+        std::string hash = resolveRevision(rev);
+        if (hash.empty()) {
+            std::cerr << "Error: Unknown revision '" << rev << "'." << std::endl;
+            return false;
+        }
+        mark(hash, UNINTERESTING);
+    }
+
+    std::vector<std::string> order;
+    while (!queue.empty()) {
+        bool onlyUninteresting = true;
+        for (const auto& item : queue) {
+            if (!(nodes[item.second].flags & UNINTERESTING)) {
+                onlyUninteresting = false;
+                break;
+            }
+        }
+        if (onlyUninteresting) break;
+
+        auto newest = std::prev(queue.end());
+        std::string hash = newest->second;
+        queue.erase(newest);
+        Node& node = nodes[hash];
+        if (node.propagated == 0) order.push_back(hash);
+        unsigned flags = node.flags;
+        node.propagated = flags;
+        if (!node.parentHash.empty()) mark(node.parentHash, flags);
+    }
+
+    commits.clear();
+    for (const std::string& hash : order) {
+        if (!(nodes[hash].flags & UNINTERESTING)) commits.push_back(hash);
+    }
+    return true;
 }
 
 bool MiniGit::initRepo() {
@@ -286,7 +1296,7 @@ bool MiniGit::makeCommit(const std::string& msg) {
     newCommit.fileBlobs = stagingArea;
     newCommit.computeAndSetHash();
 
-    if (!writeFile(OBJECTS_DIR + newCommit.hash, newCommit.serialize())) {
+    if (!writeObject(newCommit.hash, newCommit.serialize())) {
         std::cerr << "Error: Could not write commit object." << std::endl;
         return false;
     }
@@ -296,6 +1306,13 @@ bool MiniGit::makeCommit(const std::string& msg) {
         return false;
     }
 
+    // Keep an existing commit-graph complete so path-limited log can keep using it.
+    if (fileExists(COMMIT_GRAPH_FILE)) {
+        Commit parent = parentHash.empty() ? Commit() : readCommit(parentHash);
+        CommitGraph::Entry entry{parentHash, newCommit.time, ChangedPathBloom::build(changedPaths(newCommit, parent))};
+        appendFile(COMMIT_GRAPH_FILE, CommitGraph::serializeEntry(newCommit.hash, entry));
+    }
+
     if (!writeFile(INDEX_FILE, "")) {
         std::cerr << "Warning: Could not clear staging area after commit." << std::endl;
     }
@@ -304,27 +1321,148 @@ bool MiniGit::makeCommit(const std::string& msg) {
     return true;
 }
 
-void MiniGit::showLog() {
+void MiniGit::showLog(const LogOptions& options) {
     if (!fileExists(MINIGIT_DIR)) {
         std::cout << "No MiniGit repository found. Run 'minigit init' first." << std::endl;
         return;
     }
 
-    std::string currentCommitHash = getHeadCommitHash();
-    if (currentCommitHash.empty()) {
-        std::cout << "No commits yet." << std::endl;
-        return;
+    // A single tip is followed through parent links (which lets the commit-graph
+    // skip commits unread); ranges are expanded into a list up front.
+    std::string currentCommitHash;
+    std::vector<std::string> listed;
+    size_t listPos = 0;
+    bool useList = false;
+    RevisionRange range;
+    if (options.revisions.empty()) {
+        currentCommitHash = getHeadCommitHash();
+        if (currentCommitHash.empty()) {
+            std::cout << "No commits yet." << std::endl;
+            return;
+        }
+    } else if (parseRevisionArgs(options.revisions, range) && range.exclude.empty() &&
+               !range.symmetric && range.include.size() == 1) {
+        currentCommitHash = resolveRevision(range.include[0]);
+        if (currentCommitHash.empty()) {
+            std::cerr << "Error: Unknown revision '" << range.include[0] << "'." << std::endl;
+            return;
+        }
+    } else {
+        if (!listRevisions(options.revisions, listed)) return;
+        useList = true;
+        currentCommitHash = listed.empty() ? "" : listed[listPos++];
+    }
+    auto next = [&](const std::string& parentHash) -> std::string {
+        if (!useList) return parentHash;
+        return listPos < listed.size() ? listed[listPos++] : "";
+    };
+
+    // Compile the output template once, not per commit.
+    std::string tmpl = options.format;
+    if (tmpl.empty()) {
+        tmpl = options.oneline ? "%h %s%n" : "commit %H%nDate:   %ad%n    %s%n%n";
+    } else {
+        tmpl += "%n";
     }
+    LogFormat format = LogFormat::compile(tmpl);
+
+    std::vector<std::string> paths;
+    for (const std::string& path : options.paths) paths.push_back(normalizePath(path));
+    bool timeLimited = options.since != LLONG_MIN || options.until != LLONG_MAX;
+    // A long walk also uses the commit-graph to see which commits come next.
+    bool longWalk = options.maxCount < 0 || options.maxCount > static_cast<long>(LOG_READ_AHEAD);
+    static const CommitGraph noGraph;
+    const CommitGraph& graph = (!paths.empty() || timeLimited || longWalk) ? loadCommitGraph() : noGraph;
+    bool graphTimes = timeLimited && graph.hasTimes() && !graph.entries.empty();
+
+    // Hint the next LOG_READ_AHEAD commits to the read-ahead thread whenever
+    // the previous batch is half used up, if they are known without reading:
+    // from the expanded list, or by following commit-graph parents.
+    size_t hintedUpTo = 0;      // listed[0, hintedUpTo) were hinted
+    std::string graphCursor;    // First commit-graph commit not hinted yet
+    bool graphCursorDone = false;
+    size_t untilHint = 0;
+    auto readAheadCommits = [&]() {
+        if (untilHint-- > 0) return;
+        untilHint = LOG_READ_AHEAD / 2;
+        std::vector<std::string> upcoming;
+        if (useList) {
+            size_t from = std::max(hintedUpTo, listPos == 0 ? 0 : listPos - 1);
+            hintedUpTo = std::min(listed.size(), from + LOG_READ_AHEAD);
+            upcoming.assign(listed.begin() + from, listed.begin() + hintedUpTo);
+        } else if (!graph.entries.empty() && !graphCursorDone) {
+            std::string hash = graphCursor.empty() ? currentCommitHash : graphCursor;
+            const CommitGraph::Entry* entry = nullptr;
+            while (upcoming.size() < LOG_READ_AHEAD && !hash.empty() && (entry = graph.find(hash))) {
+                upcoming.push_back(hash);
+                hash = entry->parentHash;
+            }
+            graphCursor = hash;
+            graphCursorDone = hash.empty() || !entry;
+        }
+        if (!upcoming.empty()) planReads(upcoming);
+    };
+
+    OutputBuffer out;
+    std::string line;
+    long shown = 0;
+    while (!currentCommitHash.empty() && !out.closed()) {
+        if (options.maxCount >= 0 && shown >= options.maxCount) break;
+        if (longWalk) readAheadCommits();
+
+        // The commit-graph lets us skip commits outside the time range, and
+        // commits the Bloom filter proves didn't touch any of the paths,
+        // without reading the commit or its parent.
+        const CommitGraph::Entry* entry = graph.find(currentCommitHash);
+        if (entry) {
+            // Commit times needn't decrease along parent links (clock skew,
+            // imported history), so an out-of-range commit is skipped, never
+            // taken as the end of the range.
+            if (graphTimes) {
+                if (entry->time < options.since || entry->time > options.until) {
+                    currentCommitHash = next(entry->parentHash);
+                    continue;
+                }
+            }
+            if (!paths.empty()) {
+                bool maybe = false;
+                for (const std::string& path : paths) {
+                    if (entry->bloom.mightContain(path)) {
+                        maybe = true;
+                        break;
+                    }
+                }
+                if (!maybe) {
+                    currentCommitHash = next(entry->parentHash);
+                    continue;
+                }
+            }
+        }
 
-    while (!currentCommitHash.empty()) {
         Commit commit = readCommit(currentCommitHash);
-        std::cout << "commit " << commit.hash << std::endl;
-        std::cout << "Date:   " << commit.timestamp << std::endl;
-        std::cout << "    " << commit.message << std::endl;
-        std::cout << std::endl;
+        if (timeLimited) {
+            if (commit.time < options.since || commit.time > options.until) {
+                currentCommitHash = next(commit.parentHash);
+                continue;
+            }
+        }
+        if (!paths.empty()) {
+            Commit parent = commit.parentHash.empty() ? Commit() : readCommit(commit.parentHash);
+            if (!touchesPaths(changedPaths(commit, parent), paths)) {
+                currentCommitHash = next(commit.parentHash);
+                continue;
+            }
+        }
+
+        line.clear();
+        format.render(line, currentCommitHash, commit.parentHash, commit.message,
+                      format.usesDate() ? commit.formatDate() : std::string(), commit.time);
+        out << line;
+        ++shown;
 
-        currentCommitHash = commit.parentHash;
+        currentCommitHash = next(commit.parentHash);
     }
+    out.flush();
 }
 
 bool MiniGit::createBranch(const std::string& name) {
@@ -377,48 +1515,58 @@ bool MiniGit::switchTo(const std::string& target) {
             return false;
         }
     } else {
-        if (!fileExists(OBJECTS_DIR + target)) {
+        targetCommitHash = resolveRevision(target);
+        if (targetCommitHash.empty()) {
             std::cerr << "Error: Neither branch '" << target << "' nor commit '" << target << "' found." << std::endl;
             return false;
         }
-        targetCommitHash = target;
         if (!writeFile(HEAD_FILE, targetCommitHash + "\n")) {
-            std::cerr << "Error: Could not update HEAD to commit " << target << std::endl;
+            std::cerr << "Error: Could not update HEAD to commit " << targetCommitHash << std::endl;
             return false;
         }
     }
 
     Commit targetCommit = readCommit(targetCommitHash);
+    std::vector<std::string> blobs;
+    for (const auto& entry : targetCommit.fileBlobs) blobs.push_back(entry.second);
+    prefetchObjects(blobs);
 
     std::error_code ec;
-    for (const auto& entry : fs::directory_iterator(".", ec)) {
-        std::string currentPath = entry.path().string();
-        if (currentPath == MINIGIT_DIR || fs::path(currentPath).filename() == "minigit" || fs::path(currentPath).filename() == "minigit.exe") continue;
+    {
+        TraceSpan span("walkWorkingTree", "walk");
+        for (const auto& entry : fs::directory_iterator(".", ec)) {
+            std::string currentPath = entry.path().string();
+            if (currentPath == MINIGIT_DIR || fs::path(currentPath).filename() == "minigit" || fs::path(currentPath).filename() == "minigit.exe") continue;
 
-        if (entry.is_directory(ec)) continue;
+            if (entry.is_directory(ec)) continue;
 
-        std::string canonicalPath = fs::relative(entry.path(), fs::current_path()).string();
+            std::string canonicalPath = fs::relative(entry.path(), fs::current_path()).string();
 
-        if (fileExists(canonicalPath) &&
-            targetCommit.fileBlobs.find(canonicalPath) == targetCommit.fileBlobs.end()) {
-            removeFile(canonicalPath);
+            if (fileExists(canonicalPath) &&
+                targetCommit.fileBlobs.find(canonicalPath) == targetCommit.fileBlobs.end()) {
+                removeFile(canonicalPath);
+            }
         }
     }
 
-    for (const auto& entry : targetCommit.fileBlobs) {
-        const std::string& filename = entry.first;
-        const std::string& blobHash = entry.second;
-        std::string blobContent = readFile(OBJECTS_DIR + blobHash);
-        if (blobContent.empty() && !fileExists(OBJECTS_DIR + blobHash)) {
-            std::cerr << "Warning: Blob " << blobHash << " for file " << filename << " not found. Skipping." << std::endl;
-            continue;
+    // Read the blobs in on-disk order, each once however many files share it.
+    TraceSpan writeSpan("writeWorkingTree", "checkout");
+    std::unordered_map<std::string, std::vector<const std::string*>> filesByBlob;
+    for (const auto& entry : targetCommit.fileBlobs) filesByBlob[entry.second].push_back(&entry.first);
+    for (const std::string& blobHash : planReads(blobs)) {
+        std::string blobContent = readObject(blobHash);
+        bool missing = blobContent.empty() && !hasObject(blobHash);
+        for (const std::string* filename : filesByBlob[blobHash]) {
+            if (missing) {
+                std::cerr << "Warning: Blob " << blobHash << " for file " << *filename << " not found. Skipping." << std::endl;
+                continue;
+            }
+            if (!writeFile(*filename, blobContent)) {
+                std::cerr << "Error: Could not restore file " << *filename << std::endl;
+                return false;
+            }
         }
-
-        if (!writeFile(filename, blobContent)) {
-            std::cerr << "Error: Could not restore file " << filename << std::endl;
-            return false;
-        }
-    }
+    }
 
     if (!writeFile(INDEX_FILE, "")) {
         std::cerr << "Warning: Could not clear staging area after checkout." << std::endl;
@@ -436,6 +1584,9 @@ bool MiniGit::mergeBranch(const std::string& name) {
 
     std::string currentBranchCommitHash = getHeadCommitHash();
     std::string targetBranchPath = HEADS_DIR + name;
+    if (!fileExists(targetBranchPath) && name.find('/') != std::string::npos) {
+        targetBranchPath = REMOTES_DIR + name; // e.g. 'merge origin/master' after a fetch
+    }
 
     if (!fileExists(targetBranchPath)) {
         std::cerr << "Error: Branch '" << name << "' does not exist." << std::endl;
@@ -466,6 +1617,12 @@ bool MiniGit::mergeBranch(const std::string& name) {
     Commit lcaCommit = readCommit(lcaHash);
     Commit currentCommit = readCommit(currentBranchCommitHash);
     Commit targetCommit = readCommit(targetBranchCommitHash);
+    std::vector<std::string> blobs;
+    for (const Commit* commit : {&lcaCommit, &currentCommit, &targetCommit}) {
+        for (const auto& entry : commit->fileBlobs) blobs.push_back(entry.second);
+    }
+    prefetchObjects(blobs);
+    planReads(blobs); // Only for the read-ahead; files are merged in path order
 
     std::map<std::string, std::string> mergedFileBlobs = currentCommit.fileBlobs;
     bool conflictDetected = false;
@@ -476,6 +1633,7 @@ bool MiniGit::mergeBranch(const std::string& name) {
     for (const auto& entry : currentCommit.fileBlobs) allFiles.insert(entry.first);
     for (const auto& entry : targetCommit.fileBlobs) allFiles.insert(entry.first);
 
+    TraceSpan mergeSpan("mergeFiles", "merge");
     for (const std::string& filename : allFiles) {
         std::string lcaContent = getFileContentFromCommit(lcaCommit, filename);
         std::string currentContent = getFileContentFromCommit(currentCommit, filename);
@@ -568,13 +1726,10 @@ bool MiniGit::mergeBranch(const std::string& name) {
 }
 
 
-void MiniGit::diffFiles(const std::string& f1, const std::string& f2) {
-    std::ifstream a(f1), b(f2);
-    if (!a.is_open() || !b.is_open()) {
-        std::cerr << "Error: Could not open one or both files for diff: " << f1 << ", " << f2 << std::endl;
-        return;
-    }
-
+// Line-by-line comparison shared by file and revision diffs. Returns whether anything differed.
+bool MiniGit::diffContents(const std::string& contentA, const std::string& contentB) {
+    TraceSpan span("diffContents", "diff");
+    std::stringstream a(contentA), b(contentB);
     std::string la, lb;
     int line = 1;
     bool hasDiff = false;
@@ -602,7 +1757,1767 @@ void MiniGit::diffFiles(const std::string& f1, const std::string& f2) {
         }
         line++;
     }
-    if (!hasDiff) {
+    return hasDiff;
+}
+
+void MiniGit::diffFiles(const std::string& f1, const std::string& f2) {
+    std::ifstream a(f1), b(f2);
+    if (!a.is_open() || !b.is_open()) {
+        std::cerr << "Error: Could not open one or both files for diff: " << f1 << ", " << f2 << std::endl;
+        return;
+    }
+    a.close();
+    b.close();
+
+    if (!diffContents(readFile(f1), readFile(f2))) {
         std::cout << "Files are identical.\n";
     }
 }
+
+// Compares the files recorded in two commits: 'diff A B', 'diff A..B', or
+// 'diff A...B' (changes on B since its common ancestor with A).
+bool MiniGit::diffRevisions(const std::vector<std::string>& args) {
+    if (!fileExists(MINIGIT_DIR)) {
+        std::cerr << "Error: Not a MiniGit repository. Run 'minigit init' first." << std::endl;
+        return false;
+    }
+
+    std::string left, right;
+    bool mergeBase = false;
+    if (args.size() == 1 && args[0].find("..") != std::string::npos) {
+        size_t dots = args[0].find("..");
+        mergeBase = args[0].compare(dots, 3, "...") == 0;
+        left = args[0].substr(0, dots);
+        right = args[0].substr(dots + (mergeBase ? 3 : 2));
+        if (left.empty()) left = "HEAD";
+        if (right.empty()) right = "HEAD";
+    } else if (args.size() == 2) {
+        left = args[0];
+        right = args[1];
+    } else {
+        std::cerr << "Error: diff expects two revisions or a range." << std::endl;
+        return false;
+    }
+
+    std::string leftHash = resolveRevision(left);
+    std::string rightHash = resolveRevision(right);
+    if (leftHash.empty() || rightHash.empty()) {
+        std::cerr << "Error: Unknown revision '" << (leftHash.empty() ? left : right) << "'." << std::endl;
+        return false;
+    }
+    if (mergeBase) {
+        leftHash = findLCA(leftHash, rightHash);
+        if (leftHash.empty()) {
+            std::cerr << "Error: Could not find a common ancestor of '" << left << "' and '" << right << "'." << std::endl;
+            return false;
+        }
+    }
+
+    Commit leftCommit = readCommit(leftHash);
+    Commit rightCommit = readCommit(rightHash);
+    std::vector<std::string> blobs;
+    for (const auto& entry : leftCommit.fileBlobs) blobs.push_back(entry.second);
+    for (const auto& entry : rightCommit.fileBlobs) blobs.push_back(entry.second);
+    prefetchObjects(blobs);
+    std::set<std::string> allFiles;
+    for (const auto& entry : leftCommit.fileBlobs) allFiles.insert(entry.first);
+    for (const auto& entry : rightCommit.fileBlobs) allFiles.insert(entry.first);
+
+    bool hasDiff = false;
+    for (const std::string& filename : allFiles) {
+        auto l = leftCommit.fileBlobs.find(filename);
+        auto r = rightCommit.fileBlobs.find(filename);
+        if (l != leftCommit.fileBlobs.end() && r != rightCommit.fileBlobs.end() && l->second == r->second) continue;
+
+        std::cout << "diff " << filename << "\n";
+        diffContents(getFileContentFromCommit(leftCommit, filename),
+                     getFileContentFromCommit(rightCommit, filename));
+        hasDiff = true;
+    }
+    if (!hasDiff) {
+        std::cout << "Revisions are identical.\n";
+    }
+    return true;
+}
+
+bool MiniGit::writeCommitGraph() {
+    if (!fileExists(MINIGIT_DIR)) {
+        std::cerr << "Error: Not a MiniGit repository. Run 'minigit init' first." << std::endl;
+        return false;
+    }
+
+    // Walk every commit reachable from the refs, reading each object once.
+    CommitGraph graph;
+    std::map<std::string, Commit> commits;
+    std::vector<std::string> pending = getRefTips();
+    while (!pending.empty()) {
+        std::string hash = pending.back();
+        pending.pop_back();
+        if (hash.empty() || commits.count(hash)) continue;
+        Commit commit = readCommit(hash);
+        pending.push_back(commit.parentHash);
+        commits.emplace(hash, std::move(commit));
+    }
+
+    for (const auto& entry : commits) {
+        const Commit& commit = entry.second;
+        auto parentIt = commits.find(commit.parentHash);
+        static const Commit noParent;
+        const Commit& parent = parentIt == commits.end() ? noParent : parentIt->second;
+        graph.entries[entry.first] = CommitGraph::Entry{commit.parentHash, commit.time,
+                                                        ChangedPathBloom::build(changedPaths(commit, parent))};
+    }
+
+    if (!writeFile(COMMIT_GRAPH_FILE, graph.serialize())) {
+        std::cerr << "Error: Could not write commit-graph." << std::endl;
+        return false;
+    }
+    std::cout << "Wrote commit-graph with " << graph.entries.size() << " commits." << std::endl;
+    return true;
+}
+
+// Rebuilds the multi-pack index from every pack index in PACK_DIR. Once it
+// exists, installPack keeps it up to date as packs are added.
+bool MiniGit::writeMultiPackIndex(bool quiet) {
+    if (!fileExists(MINIGIT_DIR)) {
+        std::cerr << "Error: Not a MiniGit repository. Run 'minigit init' first." << std::endl;
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<PackIndex> indexes = loadPackIndexes(PACK_DIR);
+    std::sort(indexes.begin(), indexes.end(),
+              [](const PackIndex& a, const PackIndex& b) { return a.packPath < b.packPath; });
+    std::vector<std::string> names;
+    std::vector<MultiPackIndex::Record> records;
+    for (const PackIndex& pack : indexes) {
+        unsigned packId = static_cast<unsigned>(names.size());
+        names.push_back(fs::path(pack.packPath).filename().string());
+        for (const PackIndex::Entry& entry : pack.all()) records.push_back({entry.hash, packId, entry.offset, entry.length});
+    }
+    std::stable_sort(records.begin(), records.end(), MultiPackIndex::byHash);
+    if (!installMultiPackIndex(names, records)) return false;
+
+    if (!quiet) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << "Wrote multi-pack index of " << records.size() << " objects in " << names.size() << " packs ("
+                  << elapsed.count() << " ms)." << std::endl;
+    }
+    return true;
+}
+
+const BitmapIndex& MiniGit::loadBitmapIndex() {
+    if (!cacheValid(BITMAPS_FILE, bitmapSignature)) {
+        bitmapCache = bitmapSignature.exists ? BitmapIndex::deserialize(readFile(BITMAPS_FILE)) : BitmapIndex();
+    }
+    return bitmapCache;
+}
+
+// Adds everything reachable from `tip` to `reach`. The walk stops at commits
+// that are already marked or have a stored bitmap (which is OR'ed in), so its
+// length is bounded by the distance to the nearest bitmapped commit.
+void MiniGit::markReachable(const BitmapIndex& index, const std::string& tip, Reachability& reach,
+                            const std::map<std::string, Commit>* loaded) {
+    reach.bits.resize(index.wordCount(), 0);
+    auto isSet = [&](long pos) { return (reach.bits[pos / 64] >> (pos % 64)) & 1; };
+    auto set = [&](long pos) { reach.bits[pos / 64] |= uint64_t(1) << (pos % 64); };
+
+    std::string current = tip;
+    while (!current.empty()) {
+        long pos = index.position(current);
+        if (pos >= 0 && isSet(pos)) break;
+        if (pos < 0 && reach.extraCommits.count(current)) break;
+
+        if (const EwahBitmap* bitmap = index.find(current)) {
+            std::vector<uint64_t> words = bitmap->decompress(index.wordCount());
+            for (size_t i = 0; i < words.size(); ++i) reach.bits[i] |= words[i];
+            break;
+        }
+
+        Commit fetched;
+        const Commit* commit = nullptr;
+        if (loaded) {
+            auto it = loaded->find(current);
+            if (it != loaded->end()) commit = &it->second;
+        }
+        if (!commit) {
+            fetched = readCommit(current);
+            commit = &fetched;
+        }
+
+        if (pos >= 0) set(pos);
+        else reach.extraCommits.insert(current);
+        for (const auto& entry : commit->fileBlobs) {
+            long blobPos = index.position(entry.second);
+            if (blobPos >= 0) set(blobPos);
+            else reach.extraBlobs.insert(entry.second);
+        }
+        current = commit->parentHash;
+    }
+}
+
+bool MiniGit::writeBitmaps() {
+    if (!fileExists(MINIGIT_DIR)) {
+        std::cerr << "Error: Not a MiniGit repository. Run 'minigit init' first." << std::endl;
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    // Order commits parents-first so each commit's blobs follow it and
+    // bitmaps of later commits extend those of earlier ones.
+    std::vector<std::string> tips = getRefTips();
+    std::map<std::string, Commit> commits;
+    std::vector<std::string> order;
+    for (const std::string& tip : tips) {
+        std::vector<std::string> chain;
+        for (std::string hash = tip; !hash.empty() && !commits.count(hash);) {
+            Commit commit = readCommit(hash);
+            chain.push_back(hash);
+            std::string parent = commit.parentHash;
+            commits.emplace(hash, std::move(commit));
+            hash = parent;
+        }
+        order.insert(order.end(), chain.rbegin(), chain.rend());
+    }
+
+    BitmapIndex index;
+    for (const std::string& hash : order) {
+        index.addObject(hash, true);
+        for (const auto& entry : commits[hash].fileBlobs) index.addObject(entry.second, false);
+    }
+
+    std::set<std::string> tipSet(tips.begin(), tips.end());
+    for (size_t i = 0; i < order.size(); ++i) {
+        if ((i + 1) % BITMAP_INTERVAL != 0 && !tipSet.count(order[i])) continue;
+        Reachability reach;
+        markReachable(index, order[i], reach, &commits);
+        index.setBitmap(order[i], EwahBitmap::compress(reach.bits));
+    }
+
+    if (!writeFile(BITMAPS_FILE, index.serialize())) {
+        std::cerr << "Error: Could not write bitmaps." << std::endl;
+        return false;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cout << "Wrote " << index.bitmapCount() << " bitmaps over " << index.objectCount()
+              << " objects in " << elapsed.count() << " ms." << std::endl;
+    return true;
+}
+
+bool MiniGit::isAncestor(const std::string& ancestor, const std::string& descendant) {
+    std::string ancestorHash = resolveRevision(ancestor);
+    std::string descendantHash = resolveRevision(descendant);
+    if (ancestorHash.empty() || descendantHash.empty()) {
+        std::cerr << "Error: Unknown revision '" << (ancestorHash.empty() ? ancestor : descendant) << "'." << std::endl;
+        return false;
+    }
+
+    const BitmapIndex& index = loadBitmapIndex();
+    Reachability reach;
+    markReachable(index, descendantHash, reach);
+    long pos = index.position(ancestorHash);
+    if (pos >= 0) return (reach.bits[pos / 64] >> (pos % 64)) & 1;
+    return reach.extraCommits.count(ancestorHash) > 0;
+}
+
+// Lists (or counts) the commits selected by revision arguments. Counting is
+// answered from reachability bitmaps: (included & ~excluded & commits).
+bool MiniGit::revList(const std::vector<std::string>& args, bool countOnly) {
+    if (!fileExists(MINIGIT_DIR)) {
+        std::cerr << "Error: Not a MiniGit repository. Run 'minigit init' first." << std::endl;
+        return false;
+    }
+
+    if (!countOnly || !fileExists(BITMAPS_FILE)) {
+        std::vector<std::string> commits;
+        if (!listRevisions(args.empty() ? std::vector<std::string>{"HEAD"} : args, commits)) return false;
+        if (countOnly) {
+            std::cout << commits.size() << std::endl;
+            return true;
+        }
+        OutputBuffer out;
+        for (const std::string& hash : commits) {
+            if (out.closed()) break;
+            out << hash << '\n';
+        }
+        return true;
+    }
+
+    RevisionRange range;
+    if (!parseRevisionArgs(args.empty() ? std::vector<std::string>{"HEAD"} : args, range)) {
+        std::cerr << "Error: Invalid revision arguments." << std::endl;
+        return false;
+    }
+    const BitmapIndex& index = loadBitmapIndex();
+    auto reachOf = [&](const std::vector<std::string>& revs, Reachability& reach) {
+        reach.bits.assign(index.wordCount(), 0);
+        for (const std::string& rev : revs) {
+            std::string hash = resolveRevision(rev);
+            if (hash.empty()) {
+                std::cerr << "Error: Unknown revision '" << rev << "'." << std::endl;
+                return false;
+            }
+            markReachable(index, hash, reach);
+        }
+        return true;
+    };
+    // Commits in `a` but not in `b`.
+    std::vector<uint64_t> mask = index.commitMask();
+    auto countOnlyIn = [&](const Reachability& a, const Reachability& b) {
+        size_t count = 0;
+        for (size_t i = 0; i < mask.size(); ++i) {
+            count += static_cast<size_t>(__builtin_popcountll(a.bits[i] & ~b.bits[i] & mask[i]));
+        }
+        for (const std::string& hash : a.extraCommits) count += b.extraCommits.count(hash) ? 0 : 1;
+        return count;
+    };
+
+    Reachability included, excluded;
+    size_t count = 0;
+    if (range.symmetric) {
+        if (range.include.size() != 2 ||
+            !reachOf({range.include[0]}, included) || !reachOf({range.include[1]}, excluded)) return false;
+        count = countOnlyIn(included, excluded) + countOnlyIn(excluded, included);
+    } else {
+        if (!reachOf(range.include, included) || !reachOf(range.exclude, excluded)) return false;
+        count = countOnlyIn(included, excluded);
+    }
+    std::cout << count << std::endl;
+    return true;
+}
+
+// Removes unreachable objects and packs everything reachable into one pack.
+// Roots are HEAD, every branch and the staging area (MiniGit keeps no reflogs).
+// Commits to mark are enumerated via the commit-graph/bitmaps where possible,
+// then read in parallel to collect their blobs.
+bool MiniGit::collectGarbage(long long pruneAgeSeconds) {
+    if (!fileExists(MINIGIT_DIR)) {
+        std::cerr << "Error: Not a MiniGit repository. Run 'minigit init' first." << std::endl;
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    loadPacks(); // Before any worker thread reads objects
+
+    std::unordered_set<std::string> reachable;
+    for (const auto& entry : readStagingArea()) reachable.insert(entry.second);
+
+    // Enumerate reachable commits. Bitmapped commits contribute their whole
+    // history at once; commit-graph entries give parents without reading.
+    const BitmapIndex& bitmaps = loadBitmapIndex();
+    const CommitGraph& graph = loadCommitGraph();
+    std::vector<uint64_t> bits(bitmaps.wordCount(), 0);
+    std::vector<std::string> unread; // Commits whose blobs still need collecting
+    std::unordered_set<std::string> seen;
+    for (const std::string& tip : getRefTips()) {
+        for (std::string hash = tip; !hash.empty() && seen.insert(hash).second;) {
+            if (const EwahBitmap* bitmap = bitmaps.find(hash)) {
+                std::vector<uint64_t> words = bitmap->decompress(bitmaps.wordCount());
+                for (size_t i = 0; i < words.size(); ++i) bits[i] |= words[i];
+                break;
+            }
+            reachable.insert(hash);
+            if (const CommitGraph::Entry* entry = graph.find(hash)) {
+                unread.push_back(hash);
+                hash = entry->parentHash;
+            } else {
+                Commit commit = readCommit(hash);
+                for (const auto& blob : commit.fileBlobs) reachable.insert(blob.second);
+                hash = commit.parentHash;
+            }
+        }
+    }
+    for (size_t pos = 0; pos < bitmaps.objectCount(); ++pos) {
+        if ((bits[pos / 64] >> (pos % 64)) & 1) reachable.insert(bitmaps.objectAt(pos));
+    }
+
+    // Parallel mark: workers claim commits by index and collect their blobs locally.
+    unsigned threadCount = std::max(1u, std::min<unsigned>(std::thread::hardware_concurrency(),
+                                                           static_cast<unsigned>(unread.size() / 64 + 1)));
+    std::atomic<size_t> nextCommit(0);
+    std::mutex mergeLock;
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threadCount; ++t) {
+        workers.emplace_back([&]() {
+            TraceSpan span("markCommits", "gc");
+            std::vector<std::string> blobs;
+            for (size_t i = nextCommit++; i < unread.size(); i = nextCommit++) {
+                Commit commit = Commit::deserialize(readObject(unread[i]));
+                for (const auto& blob : commit.fileBlobs) blobs.push_back(blob.second);
+            }
+            std::lock_guard<std::mutex> guard(mergeLock);
+            reachable.insert(blobs.begin(), blobs.end());
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+
+    // Sweep unreachable loose objects older than the grace period.
+    auto now = fs::file_time_type::clock::now();
+    auto grace = std::chrono::seconds(pruneAgeSeconds);
+    size_t prunedObjects = 0;
+    unsigned long long prunedBytes = 0;
+    std::vector<std::string> packedLoose; // Reachable loose objects, removed once packed
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(OBJECTS_DIR, ec)) {
+        if (!entry.is_regular_file(ec)) continue;
+        std::string hash = entry.path().filename().string();
+        if (reachable.count(hash)) {
+            packedLoose.push_back(hash);
+            continue;
+        }
+        if (now - entry.last_write_time(ec) < grace) continue;
+        unsigned long long size = entry.file_size(ec);
+        if (removeFile(entry.path().string())) {
+            ++prunedObjects;
+            prunedBytes += size;
+        }
+    }
+
+    // Repack: write every reachable object into a single new pack. Unreachable
+    // objects from packs still inside the grace period are kept as loose objects.
+    std::vector<std::string> oldPacks;
+    unsigned long long oldPackBytes = 0;
+    for (const PackIndex& pack : loadPackIndexes(PACK_DIR)) {
+        oldPacks.push_back(pack.packPath);
+        oldPackBytes += fs::file_size(pack.packPath, ec);
+        auto packTime = fs::last_write_time(pack.packPath, ec);
+        bool recent = now - packTime < grace;
+        for (const PackIndex::Entry& entry : pack.all()) {
+            if (reachable.count(entry.hash)) continue;
+            if (recent) {
+                // Keep the pack's age so the grace period isn't restarted.
+                std::string content;
+                if (pack.read(entry, content) && writeObject(entry.hash, content)) {
+                    fs::last_write_time(OBJECTS_DIR + entry.hash, packTime, ec);
+                }
+            } else {
+                ++prunedObjects;
+                prunedBytes += entry.length;
+            }
+        }
+    }
+
+    std::vector<std::string> toPack;
+    for (const std::string& hash : reachable) {
+        if (hasLocalObject(hash)) toPack.push_back(hash); // Objects borrowed from alternates stay there
+    }
+    std::sort(toPack.begin(), toPack.end());
+
+    std::string newPackPath;
+    unsigned long long newPackBytes = 0;
+    if (!toPack.empty()) {
+        if (!createDirectory(PACK_DIR)) return false;
+        std::string tmpPath = PACK_DIR + "tmp-pack";
+        PackWriter writer(tmpPath);
+        if (!writer.isOpen()) {
+            std::cerr << "Error: Could not create pack file." << std::endl;
+            return false;
+        }
+        for (const std::string& hash : toPack) {
+            if (!writer.add(hash, readObject(hash))) {
+                std::cerr << "Error: Could not write pack file." << std::endl;
+                removeFile(tmpPath);
+                return false;
+            }
+        }
+        newPackBytes = writer.bytesWritten();
+        newPackPath = installPack(writer, tmpPath);
+        if (newPackPath.empty()) return false;
+    }
+
+    // Only now that the new pack is in place is it safe to drop the old copies.
+    for (const std::string& packPath : oldPacks) {
+        if (packPath == newPackPath) continue;
+        removeFile(packPath.substr(0, packPath.size() - 5) + ".idx");
+        removeFile(packPath);
+    }
+    for (const std::string& hash : packedLoose) removeFile(OBJECTS_DIR + hash);
+    if (fileExists(MULTI_PACK_INDEX_FILE)) writeMultiPackIndex(true);
+    objectCache.clear(); // It may hold objects that were just pruned
+    loadPacks();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cout << "Pruned " << prunedObjects << " unreachable objects (" << prunedBytes << " bytes reclaimed)." << std::endl;
+    std::cout << "Packed " << toPack.size() << " objects (" << packedLoose.size() << " loose, "
+              << oldPackBytes << " bytes of old packs) into " << newPackBytes << " bytes." << std::endl;
+    std::cout << "Marked with " << threadCount << " thread(s); gc took " << elapsed.count() << " ms." << std::endl;
+    return true;
+}
+
+// Verifies the repository: every object's content matches its name, every
+// ref points at an existing commit, and every commit reachable from the refs
+// has its parent and blobs. Objects are rehashed by a pool of threads, each
+// streaming its objects through a fixed-size buffer. Returns false on any problem.
+bool MiniGit::checkIntegrity() {
+    if (!fileExists(MINIGIT_DIR)) {
+        std::cerr << "Error: Not a MiniGit repository. Run 'minigit init' first." << std::endl;
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    loadPacks(); // Before any worker thread reads objects
+
+    struct ObjectLocation {
+        std::string hash;
+        std::string path;              // Loose object file or pack file
+        unsigned long long offset;
+        unsigned long long length;
+        bool packed;
+    };
+    std::vector<ObjectLocation> objects;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(OBJECTS_DIR, ec)) {
+        if (!entry.is_regular_file(ec)) continue;
+        objects.push_back({entry.path().filename().string(), entry.path().string(), 0, 0, false});
+    }
+    for (const PackIndex& pack : loadPackIndexes(PACK_DIR)) {
+        for (const PackIndex::Entry& entry : pack.all()) {
+            objects.push_back({entry.hash, pack.packPath, entry.offset, entry.length, true});
+        }
+    }
+
+    std::atomic<size_t> nextObject(0);
+    std::atomic<size_t> problems(0);
+    std::mutex reportLock;
+    auto report = [&](const std::string& message) {
+        ++problems;
+        std::lock_guard<std::mutex> guard(reportLock);
+        std::cerr << "error: " << message << std::endl;
+    };
+
+    unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threadCount; ++t) {
+        workers.emplace_back([&]() {
+            TraceSpan span("checkObjects", "fsck");
+            std::vector<char> buffer(64 * 1024);
+            for (size_t i = nextObject++; i < objects.size(); i = nextObject++) {
+                const ObjectLocation& object = objects[i];
+                std::ifstream in(object.path, std::ios::binary);
+                if (!in.is_open()) {
+                    report("cannot open " + object.path + " for object " + object.hash);
+                    continue;
+                }
+                if (object.packed) in.seekg(static_cast<std::streamoff>(object.offset));
+                SimpleHasher hasher;
+                unsigned long long remaining = object.length;
+                while (in && (!object.packed || remaining > 0)) {
+                    size_t want = buffer.size();
+                    if (object.packed && remaining < want) want = static_cast<size_t>(remaining);
+                    in.read(buffer.data(), static_cast<std::streamsize>(want));
+                    size_t got = static_cast<size_t>(in.gcount());
+                    if (got == 0) break;
+                    hasher.update(buffer.data(), got);
+                    remaining -= std::min<unsigned long long>(remaining, got);
+                }
+                if (object.packed && remaining > 0) {
+                    report("object " + object.hash + " is truncated in " + object.path);
+                } else if (hasher.hex() != object.hash) {
+                    report("hash mismatch for object " + object.hash + " in " + object.path +
+                           " (content hashes to " + hasher.hex() + ")");
+                }
+            }
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+
+    // Refs must name existing commits; an empty branch (before the first commit) is fine.
+    std::vector<std::pair<std::string, std::string>> refs;
+    refs.emplace_back("HEAD", getHeadCommitHash());
+    for (const auto& branch : listBranches()) {
+        refs.emplace_back("refs/heads/" + branch.first, branch.second);
+    }
+    for (const auto& ref : listRemoteRefs()) {
+        refs.emplace_back("refs/remotes/" + ref.first, ref.second);
+    }
+
+    // Connectivity of everything reachable from the refs. A partial clone may
+    // lack blobs, but never commits.
+    std::unordered_set<std::string> checked;
+    bool partial = fileExists(PROMISOR_FILE);
+    std::unique_ptr<RemoteRepository> promisor;
+    if (partial) promisor = std::make_unique<RemoteRepository>(promisorPath());
+    size_t promised = 0;
+    for (const auto& ref : refs) {
+        if (ref.second.empty()) continue;
+        if (!hasObject(ref.second)) {
+            report(ref.first + " points to missing commit " + ref.second);
+            continue;
+        }
+        for (std::string hash = ref.second; !hash.empty() && checked.insert(hash).second;) {
+            std::string data = readObject(hash);
+            if (data.rfind("message:", 0) != 0) {
+                report("object " + hash + " is not a commit");
+                break;
+            }
+            Commit commit = Commit::deserialize(data);
+            if (isShallow(hash)) commit.parentHash.clear(); // History ends here by design
+            for (const auto& blob : commit.fileBlobs) {
+                if (hasObject(blob.second)) continue;
+                if (partial && promisor->canSupply(blob.second)) {
+                    ++promised; // Fetched from the promisor on first use
+                } else if (partial) {
+                    report("commit " + hash + " references blob " + blob.second + " for " + blob.first +
+                           ", missing here and in the promisor " + promisorPath());
+                } else {
+                    report("commit " + hash + " references missing blob " + blob.second + " for " + blob.first);
+                }
+            }
+            if (!commit.parentHash.empty() && !hasObject(commit.parentHash)) {
+                report("commit " + hash + " has missing parent " + commit.parentHash);
+                break;
+            }
+            hash = commit.parentHash;
+        }
+    }
+    for (const auto& entry : readStagingArea()) {
+        if (!hasObject(entry.second)) {
+            report("staging area references missing blob " + entry.second + " for " + entry.first);
+        }
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cout << "Checked " << objects.size() << " objects and " << checked.size() << " reachable commits with "
+              << threadCount << " thread(s) in " << elapsed.count() << " ms: "
+              << problems.load() << " problem(s) found." << std::endl;
+    if (promised > 0) std::cout << promised << " blob reference(s) left to the promisor " << promisorPath() << "." << std::endl;
+    return problems.load() == 0;
+}
+
+// Reads a fast-import stream and writes its objects straight into one new
+// pack, without touching the working tree or the staging area:
+//
+//   blob                          commit refs/heads/<branch>
+//   mark :<n>                     mark :<n>
+//   data <size>                   timestamp <epoch> <+hhmm>   (optional)
+//   <size bytes>                  data <size>
+//                                 <message bytes>
+//   reset refs/heads/<branch>     from <:mark|revision>       (optional)
+//   from <:mark|revision>         M <:mark|blob-hash> <path>
+//                                 D <path>
+//   done                          deleteall
+//
+// A commit's files start as its parent's and are then modified by its M/D
+// lines; without 'from' the parent is the branch's current tip. Marks live in
+// memory only. Branches are updated once the pack is installed.
+bool MiniGit::fastImport(std::istream& in) {
+    if (!fileExists(MINIGIT_DIR)) {
+        std::cerr << "Error: Not a MiniGit repository. Run 'minigit init' first." << std::endl;
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    if (!createDirectory(PACK_DIR)) return false;
+    std::string tmpPath = PACK_DIR + "tmp-import-" + std::to_string(::getpid());
+    PackWriter writer(tmpPath);
+    if (!writer.isOpen()) {
+        std::cerr << "Error: Could not create pack file." << std::endl;
+        return false;
+    }
+
+    std::unordered_map<std::string, std::string> marks;
+    std::map<std::string, std::string> branchTips;   // Branch -> commit, as updated by the stream
+    std::unordered_map<std::string, std::map<std::string, std::string>> tipFiles; // Commit -> files, for tips only
+    std::string graphEntries;
+    bool updateGraph = fileExists(COMMIT_GRAPH_FILE);
+    size_t blobCount = 0, commitCount = 0;
+    std::string line, pending;
+    bool havePending = false;
+
+    auto fail = [&](const std::string& message) {
+        std::cerr << "Error: fast-import: " << message << std::endl;
+        writer.finish();
+        removeFile(tmpPath);
+        return false;
+    };
+    auto nextLine = [&](std::string& out) -> bool {
+        if (havePending) {
+            out = pending;
+            havePending = false;
+            return true;
+        }
+        return static_cast<bool>(std::getline(in, out));
+    };
+    auto readData = [&](std::string& data) -> bool {
+        std::string header;
+        if (!nextLine(header) || header.rfind("data ", 0) != 0) return false;
+        unsigned long long size;
+        if (!parseDecimal(header.substr(5), size)) return false;
+        // Read in bounded chunks, so a bogus size runs into the end of the
+        // stream instead of allocating it up front.
+        data.clear();
+        while (data.size() < size) {
+            size_t chunk = static_cast<size_t>(std::min<unsigned long long>(size - data.size(), 1 << 20));
+            size_t done = data.size();
+            data.resize(done + chunk);
+            if (!in.read(&data[done], static_cast<std::streamsize>(chunk))) return false;
+        }
+        if (in.peek() == '\n') in.get();
+        return true;
+    };
+    auto store = [&](const std::string& hash, const std::string& content) -> bool {
+        if (writer.contains(hash) || hasObject(hash)) return true;
+        return writer.add(hash, content);
+    };
+    auto branchOf = [](const std::string& ref) {
+        return ref.rfind("refs/heads/", 0) == 0 ? ref.substr(11) : ref;
+    };
+    auto resolveFrom = [&](const std::string& ref) -> std::string {
+        if (!ref.empty() && ref[0] == ':') {
+            auto it = marks.find(ref);
+            return it == marks.end() ? "" : it->second;
+        }
+        auto tip = branchTips.find(branchOf(ref));
+        if (tip != branchTips.end()) return tip->second;
+        return resolveRevision(ref);
+    };
+    auto filesOf = [&](const std::string& commitHash) -> std::map<std::string, std::string> {
+        if (commitHash.empty()) return {};
+        auto it = tipFiles.find(commitHash);
+        if (it != tipFiles.end()) return it->second;
+        std::string content;
+        if (!writer.read(commitHash, content)) content = readObject(commitHash);
+        return Commit::deserialize(content).fileBlobs;
+    };
+
+    while (nextLine(line)) {
+        if (line.empty()) continue;
+        if (line == "done") break;
+
+        std::string mark;
+        if (line == "blob") {
+            std::string data;
+            if (nextLine(line) && line.rfind("mark ", 0) == 0) mark = line.substr(5);
+            else havePending = true, pending = line;
+            if (!readData(data)) return fail("expected 'data <size>' after 'blob'");
+            std::string hash = computeSimpleHash(data);
+            if (!store(hash, data)) return fail("could not write pack");
+            if (!mark.empty()) marks[mark] = hash;
+            ++blobCount;
+        } else if (line.rfind("commit ", 0) == 0) {
+            std::string branch = branchOf(line.substr(7));
+            Commit commit;
+            std::string timestamp;
+            while (nextLine(line)) {
+                if (line.rfind("mark ", 0) == 0) mark = line.substr(5);
+                else if (line.rfind("timestamp ", 0) == 0) timestamp = line.substr(10);
+                else {
+                    havePending = true;
+                    pending = line;
+                    break;
+                }
+            }
+            if (!readData(commit.message)) return fail("expected 'data <size>' for commit message");
+            // Commit objects are line-based, so the message is kept on one line.
+            while (!commit.message.empty() && commit.message.back() == '\n') commit.message.pop_back();
+            std::replace(commit.message.begin(), commit.message.end(), '\n', ' ');
+            if (timestamp.empty()) {
+                Commit now("", "");
+                commit.time = now.time;
+                commit.tzOffset = now.tzOffset;
+            } else if (!parseEpochTimestamp(timestamp, commit.time, commit.tzOffset)) {
+                // fast-export writes commits from before epoch timestamps in their legacy form.
+                if (!parseLocalTime(timestamp, commit.time, &commit.tzOffset)) {
+                    return fail("invalid timestamp '" + timestamp + "'");
+                }
+                commit.legacyTimestamp = timestamp;
+            }
+
+            auto tip = branchTips.find(branch);
+            if (tip != branchTips.end()) {
+                commit.parentHash = tip->second;
+            } else if (fileExists(HEADS_DIR + branch)) {
+                commit.parentHash = resolveRevision(branch);
+            }
+            bool filesLoaded = false;
+            while (nextLine(line)) {
+                if (line.empty()) break;
+                if (line.rfind("from ", 0) == 0) {
+                    commit.parentHash = resolveFrom(line.substr(5));
+                    if (commit.parentHash.empty()) return fail("unknown 'from' " + line.substr(5));
+                    continue;
+                }
+                if (!filesLoaded) {
+                    commit.fileBlobs = filesOf(commit.parentHash);
+                    filesLoaded = true;
+                }
+                if (line == "deleteall") {
+                    commit.fileBlobs.clear();
+                } else if (line.rfind("M ", 0) == 0) {
+                    size_t space = line.find(' ', 2);
+                    if (space == std::string::npos) return fail("malformed line: " + line);
+                    std::string ref = line.substr(2, space - 2);
+                    std::string blob = ref[0] == ':' ? (marks.count(ref) ? marks[ref] : "") : ref;
+                    if (blob.empty()) return fail("unknown mark " + ref);
+                    commit.fileBlobs[line.substr(space + 1)] = blob;
+                } else if (line.rfind("D ", 0) == 0) {
+                    commit.fileBlobs.erase(line.substr(2));
+                } else {
+                    havePending = true;
+                    pending = line;
+                    break;
+                }
+            }
+            if (!filesLoaded) commit.fileBlobs = filesOf(commit.parentHash);
+
+            commit.computeAndSetHash();
+            if (!store(commit.hash, commit.serialize())) return fail("could not write pack");
+            if (updateGraph) {
+                Commit parent;
+                parent.fileBlobs = filesOf(commit.parentHash);
+                CommitGraph::Entry entry{commit.parentHash, commit.time,
+                                         ChangedPathBloom::build(changedPaths(commit, parent))};
+                graphEntries += CommitGraph::serializeEntry(commit.hash, entry);
+            }
+            if (!mark.empty()) marks[mark] = commit.hash;
+            if (tip != branchTips.end()) tipFiles.erase(tip->second);
+            branchTips[branch] = commit.hash;
+            tipFiles[commit.hash] = commit.fileBlobs;
+            ++commitCount;
+        } else if (line.rfind("reset ", 0) == 0) {
+            std::string branch = branchOf(line.substr(6));
+            std::string target;
+            if (nextLine(line) && line.rfind("from ", 0) == 0) {
+                target = resolveFrom(line.substr(5));
+                if (target.empty()) return fail("unknown 'from' " + line.substr(5));
+            } else {
+                havePending = true;
+                pending = line;
+            }
+            branchTips[branch] = target;
+        } else {
+            return fail("unsupported command: " + line);
+        }
+    }
+
+    unsigned long long packBytes = writer.bytesWritten();
+    size_t packed = writer.objectCount();
+    if (packed > 0) {
+        if (installPack(writer, tmpPath).empty()) return false;
+    } else {
+        writer.finish();
+        removeFile(tmpPath);
+    }
+    if (!graphEntries.empty()) appendFile(COMMIT_GRAPH_FILE, graphEntries);
+    for (const auto& tip : branchTips) {
+        if (!writeFile(HEADS_DIR + tip.first, tip.second + "\n")) {
+            std::cerr << "Error: Could not update branch " << tip.first << std::endl;
+            return false;
+        }
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cout << "Imported " << blobCount << " blobs and " << commitCount << " commits (" << packed
+              << " new objects, " << packBytes << " bytes packed) in " << elapsed.count() << " ms." << std::endl;
+    return true;
+}
+
+// Writes the history of the given branches (all branches if none are given)
+// as a stream fast-import can replay. Commits come parents first, each one as
+// its changes against its parent; each blob is written once, just before the
+// first commit that uses it, and is copied straight from the object store.
+// Every commit carries its stored timestamp, so an import reproduces the
+// same commit hashes.
+bool MiniGit::fastExport(const std::vector<std::string>& branches) {
+    if (!fileExists(MINIGIT_DIR)) {
+        std::cerr << "Error: Not a MiniGit repository. Run 'minigit init' first." << std::endl;
+        return false;
+    }
+    std::map<std::string, std::string> allBranches = listBranches();
+    std::vector<std::pair<std::string, std::string>> tips;
+    if (branches.empty()) {
+        for (const auto& branch : allBranches) {
+            if (!branch.second.empty()) tips.push_back(branch);
+        }
+    } else {
+        for (const std::string& name : branches) {
+            auto it = allBranches.find(name);
+            if (it == allBranches.end()) {
+                std::cerr << "Error: Branch '" << name << "' does not exist." << std::endl;
+                return false;
+            }
+            if (!it->second.empty()) tips.push_back(*it);
+        }
+    }
+
+    // Topological order: walk back from each tip until history already
+    // claimed by an earlier branch, then emit that stretch oldest first.
+    std::vector<std::pair<std::string, const std::string*>> order; // Commit, branch it is exported on
+    std::unordered_set<std::string> seen;
+    for (const auto& tip : tips) {
+        std::vector<std::string> chain;
+        for (std::string hash = tip.second; !hash.empty() && !seen.count(hash); hash = readCommit(hash).parentHash) {
+            seen.insert(hash);
+            chain.push_back(hash);
+        }
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) order.emplace_back(*it, &tip.first);
+    }
+
+    OutputBuffer out;
+    std::unordered_map<std::string, size_t> marks; // Blob or commit hash -> mark
+    size_t nextMark = 1;
+    Commit previous;
+    for (const auto& item : order) {
+        if (out.closed()) return true;
+        Commit commit = readCommit(item.first);
+        commit.hash = item.first;
+        if (!commit.parentHash.empty() && commit.parentHash != previous.hash) {
+            previous = readCommit(commit.parentHash); // Start of a new branch's stretch
+            previous.hash = commit.parentHash;
+        }
+        static const std::map<std::string, std::string> noFiles;
+        const std::map<std::string, std::string>& parentFiles = commit.parentHash.empty() ? noFiles : previous.fileBlobs;
+
+        std::string changes;
+        for (const auto& file : commit.fileBlobs) {
+            auto old = parentFiles.find(file.first);
+            if (old != parentFiles.end() && old->second == file.second) continue;
+            auto mark = marks.find(file.second);
+            if (mark == marks.end()) {
+                ObjectStream blob;
+                if (!openObject(file.second, blob)) {
+                    std::cerr << "Error: Missing blob " << file.second << " for '" << file.first << "' in commit "
+                              << commit.hash << std::endl;
+                    return false;
+                }
+                mark = marks.emplace(file.second, nextMark++).first;
+                out << "blob\nmark :" << std::to_string(mark->second) << "\ndata " << std::to_string(blob.size()) << '\n';
+                if (!blob.copyTo(out)) {
+                    if (out.closed()) return true;
+                    std::cerr << "Error: Could not read blob " << file.second << std::endl;
+                    return false;
+                }
+                out << '\n';
+            }
+            changes += "M :" + std::to_string(mark->second) + " " + file.first + "\n";
+        }
+        for (const auto& file : parentFiles) {
+            if (!commit.fileBlobs.count(file.first)) changes += "D " + file.first + "\n";
+        }
+
+        std::string ref = "refs/heads/" + *item.second;
+        if (commit.parentHash.empty()) out << "reset " << ref << "\n\n";
+        size_t mark = nextMark++;
+        marks[commit.hash] = mark;
+        out << "commit " << ref << "\nmark :" << std::to_string(mark) << "\ntimestamp " << commit.timestampText()
+            << "\ndata " << std::to_string(commit.message.size()) << '\n' << commit.message << '\n';
+        if (!commit.parentHash.empty()) {
+            auto parentMark = marks.find(commit.parentHash);
+            out << "from " << (parentMark != marks.end() ? ":" + std::to_string(parentMark->second) : commit.parentHash) << '\n';
+        }
+        out << changes << '\n';
+        previous = std::move(commit);
+    }
+
+    for (const auto& tip : tips) {
+        out << "reset refs/heads/" << tip.first << "\nfrom :" << std::to_string(marks[tip.second]) << "\n\n";
+    }
+    out << "done\n";
+    return true;
+}
+
+// Streams a commit's files to stdout as a tar archive (gzip-compressed through
+// 'gzip -cn' if requested) without touching the working tree or the index.
+// Worker threads read blobs ahead of the writer, at most ARCHIVE_READ_AHEAD
+// files beyond it, while entries are written in path order.
+bool MiniGit::archive(const std::string& rev, const std::string& prefix, bool gzip) {
+    if (!fileExists(MINIGIT_DIR)) {
+        std::cerr << "Error: Not a MiniGit repository. Run 'minigit init' first." << std::endl;
+        return false;
+    }
+    std::string commitHash = resolveRevision(rev);
+    if (commitHash.empty()) {
+        std::cerr << "Error: Unknown revision '" << rev << "'." << std::endl;
+        return false;
+    }
+    Commit commit = readCommit(commitHash);
+    std::vector<std::pair<std::string, std::string>> files; // Archive path, blob
+    for (const auto& file : commit.fileBlobs) files.emplace_back(prefix + normalizePath(file.first), file.second);
+    std::sort(files.begin(), files.end());
+
+    int outFd = STDOUT_FILENO;
+    pid_t compressor = -1;
+    if (gzip) {
+        int pipeFds[2];
+        if (::pipe(pipeFds) != 0) {
+            std::cerr << "Error: Could not create pipe: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        compressor = ::fork();
+        if (compressor == 0) {
+            ::dup2(pipeFds[0], STDIN_FILENO);
+            ::close(pipeFds[0]);
+            ::close(pipeFds[1]);
+            ::execlp("gzip", "gzip", "-cn", static_cast<char*>(nullptr));
+            std::perror("gzip");
+            ::_exit(127);
+        }
+        ::close(pipeFds[0]);
+        if (compressor < 0) {
+            ::close(pipeFds[1]);
+            std::cerr << "Error: Could not start gzip: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        outFd = pipeFds[1];
+    }
+
+    std::vector<std::string> blobs;
+    for (const auto& file : files) blobs.push_back(file.second);
+    prefetchObjects(blobs);
+    loadPacks(); // Before any worker thread reads objects
+    std::vector<std::string> contents(files.size());
+    std::vector<char> ready(files.size(), 0);
+    std::vector<char> missing(files.size(), 0);
+    size_t written = 0;      // Next entry the writer needs
+    bool stop = false;       // Writer gave up (closed pipe or missing blob)
+    std::atomic<size_t> nextFile(0);
+    std::mutex lock;
+    std::condition_variable readyChanged, writerMoved;
+
+    unsigned threadCount = std::max(1u, std::min<unsigned>(std::thread::hardware_concurrency(),
+                                                           static_cast<unsigned>(files.size() / 16 + 1)));
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threadCount; ++t) {
+        workers.emplace_back([&]() {
+            for (size_t i = nextFile++; i < files.size(); i = nextFile++) {
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    writerMoved.wait(guard, [&]() { return stop || i < written + ARCHIVE_READ_AHEAD; });
+                    if (stop) return;
+                }
+                std::string content = readObject(files[i].second);
+                bool found = !content.empty() || hasObject(files[i].second);
+                std::lock_guard<std::mutex> guard(lock);
+                contents[i] = std::move(content);
+                missing[i] = !found;
+                ready[i] = 1;
+                readyChanged.notify_all();
+            }
+        });
+    }
+
+    bool ok = true;
+    {
+        OutputBuffer out(outFd);
+        TarWriter tar(out);
+        tar.addGlobalComment(commitHash);
+        for (size_t i = 0; i < files.size() && !out.closed(); ++i) {
+            std::string content;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                readyChanged.wait(guard, [&]() { return ready[i] != 0; });
+                if (missing[i]) {
+                    std::cerr << "Error: Missing blob " << files[i].second << " for '" << files[i].first << "'." << std::endl;
+                    ok = false;
+                    break;
+                }
+                content.swap(contents[i]);
+                written = i + 1;
+                writerMoved.notify_all();
+            }
+            tar.addFile(files[i].first, content, commit.time);
+        }
+        if (ok) tar.finish();
+        std::lock_guard<std::mutex> guard(lock);
+        stop = true;
+        writerMoved.notify_all();
+    }
+    for (std::thread& worker : workers) worker.join();
+
+    if (gzip) {
+        ::close(outFd);
+        int status = 0;
+        ::waitpid(compressor, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cerr << "Error: gzip failed." << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// "origin" (or nothing) names the repository recorded by clone; anything else is a path.
+std::string MiniGit::remotePath(const std::string& name) {
+    if (!name.empty() && name != "origin") return name;
+    std::string path = readFile(ORIGIN_FILE);
+    if (!path.empty() && path.back() == '\n') path.pop_back();
+    return path;
+}
+
+// Clones `source` into a new directory. Objects and packs are immutable, so
+// they are hardlinked when both repositories are on the same filesystem and
+// copied otherwise; with `shared`, nothing is copied and the source's object
+// directory is listed as an alternate instead. A `blobless` clone copies only
+// the commits into a pack and records the source as its promisor, fetching
+// blobs when they are first needed. A nonzero `depth` copies only that many
+// commits of each branch and records where history was cut in SHALLOW_FILE.
+// Every remote branch becomes a local branch and a remote-tracking ref, and
+// the remote's current branch is checked out.
+bool MiniGit::cloneRepository(const std::string& source, const std::string& directory, bool shared, bool blobless,
+                              size_t depth) {
+    std::error_code ec;
+    std::string sourcePath = fs::absolute(source, ec).lexically_normal().string();
+    RemoteRepository remote(sourcePath);
+    if (!remote.isRepository()) {
+        std::cerr << "Error: '" << source << "' is not a MiniGit repository." << std::endl;
+        return false;
+    }
+    if (fs::exists(directory, ec) && !fs::is_empty(directory, ec)) {
+        std::cerr << "Error: Destination '" << directory << "' already exists and is not empty." << std::endl;
+        return false;
+    }
+    if (!createDirectory(directory)) return false;
+
+    // The repository layout is relative to the working directory, so the
+    // clone is built by a fresh MiniGit from inside the new directory.
+    fs::path previous = fs::current_path(ec);
+    fs::current_path(directory, ec);
+    if (ec) {
+        std::cerr << "Error: Could not enter '" << directory << "': " << ec.message() << std::endl;
+        return false;
+    }
+    std::cout << "Cloning into '" << directory << "'..." << std::endl;
+    MiniGit clone;
+    bool ok = clone.populateClone(remote, sourcePath, shared, blobless, depth);
+    fs::current_path(previous, ec);
+    return ok;
+}
+
+bool MiniGit::populateClone(RemoteRepository& remote, const std::string& sourcePath, bool shared, bool blobless,
+                            size_t depth) {
+    auto start = std::chrono::steady_clock::now();
+    if (!createDirectory(OBJECTS_DIR) || !createDirectory(PACK_DIR) || !createDirectory(HEADS_DIR)) return false;
+
+    size_t linked = 0, copied = 0;
+    auto transfer = [&](const fs::path& from, const std::string& to) {
+        std::error_code ec;
+        fs::create_hard_link(from, to, ec);
+        if (!ec) {
+            ++linked;
+            return true;
+        }
+        fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+        if (ec) {
+            std::cerr << "Error: Could not copy " << from.string() << ": " << ec.message() << std::endl;
+            return false;
+        }
+        ++copied;
+        return true;
+    };
+    std::error_code ec;
+    // Objects the source borrows through its alternates must stay reachable.
+    // Alternates are only followed one level deep, so a full or shared clone
+    // lists the source's alternates itself; a pack clone reads them through
+    // the source and copies them.
+    std::string alternates;
+    for (const std::string& dir : remote.alternates()) alternates += dir + "\n";
+    if (shared) {
+        if (!writeFile(ALTERNATES_FILE, remote.path(OBJECTS_DIR) + "\n" + alternates)) return false;
+        packsLoaded = false;
+    } else if (blobless || depth > 0) {
+        std::vector<std::string> tips;
+        for (const auto& branch : remote.branches()) {
+            if (!branch.second.empty()) tips.push_back(branch.second);
+        }
+        std::vector<std::string> shallow, missing;
+        std::vector<std::string> objects =
+            objectsToSend(tips, {}, [&](const std::string& hash) { return remote.readObject(hash); }, !blobless, depth,
+                          &shallow, remote.shallowCommits(), &missing);
+        if (!missing.empty()) {
+            std::cerr << "Error: Commit " << missing.front() << " is missing in " << sourcePath << std::endl;
+            return false;
+        }
+        if (!shallow.empty() && !writeShallow(std::unordered_set<std::string>(shallow.begin(), shallow.end()))) {
+            return false;
+        }
+        std::string tmpPath = PACK_DIR + "tmp-clone";
+        PackWriter writer(tmpPath);
+        if (!writer.isOpen()) {
+            std::cerr << "Error: Could not create pack file." << std::endl;
+            return false;
+        }
+        auto fail = [&](const std::string& message) {
+            std::cerr << "Error: " << message << std::endl;
+            writer.finish();
+            removeFile(tmpPath);
+            return false;
+        };
+        for (const std::string& hash : objects) {
+            std::string content = remote.readObject(hash);
+            if (computeSimpleHash(content) != hash) {
+                return fail("Object " + hash + " is missing or corrupt in " + sourcePath);
+            }
+            if (!writer.add(hash, content)) return fail("Could not write pack file.");
+        }
+        copied = writer.objectCount();
+        if (copied > 0 && installPack(writer, tmpPath).empty()) return false;
+        if (copied == 0) {
+            writer.finish();
+            removeFile(tmpPath);
+        }
+        if (blobless && !writeFile(PROMISOR_FILE, sourcePath + "\n")) return false;
+    } else {
+        for (const auto& entry : fs::directory_iterator(remote.path(OBJECTS_DIR), ec)) {
+            if (!entry.is_regular_file(ec)) continue;
+            if (!transfer(entry.path(), OBJECTS_DIR + entry.path().filename().string())) return false;
+        }
+        for (const auto& entry : fs::directory_iterator(remote.path(PACK_DIR), ec)) {
+            std::string name = entry.path().filename().string();
+            if (name.rfind("pack-", 0) != 0) continue; // Skip packs still being written
+            if (!transfer(entry.path(), PACK_DIR + name)) return false;
+        }
+        if (!alternates.empty()) {
+            if (!writeFile(ALTERNATES_FILE, alternates)) return false;
+            packsLoaded = false;
+        }
+    }
+    // A full or shared clone of a shallow clone is cut off where its source is.
+    std::unordered_set<std::string> sourceShallow = remote.shallowCommits();
+    if ((shared || (!blobless && depth == 0)) && !sourceShallow.empty() && !writeShallow(sourceShallow)) return false;
+    // A full or shared clone of a partial clone lacks the same blobs the
+    // source does, so it fetches them through the source, which in turn asks
+    // its own promisor. A pack clone copied every blob it needed above.
+    if ((shared || (!blobless && depth == 0)) && !remote.promisorPath().empty() &&
+        !writeFile(PROMISOR_FILE, sourcePath + "\n")) {
+        return false;
+    }
+    invalidateObjectFilter();
+
+    std::map<std::string, std::string> branches = remote.branches();
+    for (const auto& branch : branches) {
+        if (!writeFile(HEADS_DIR + branch.first, branch.second + "\n")) return false;
+        if (!branch.second.empty() && !writeFile(REMOTES_DIR + "origin/" + branch.first, branch.second + "\n")) return false;
+    }
+    std::string head = remote.headBranch();
+    if (head.empty() || !branches.count(head)) head = branches.empty() ? "master" : branches.begin()->first;
+    if (!branches.count(head) && !writeFile(HEADS_DIR + head, "\n")) return false;
+    if (!writeFile(HEAD_FILE, "ref: refs/heads/" + head + "\n") || !writeFile(INDEX_FILE, "") ||
+        !writeFile(ORIGIN_FILE, sourcePath + "\n")) {
+        return false;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    if (shared) {
+        std::cout << "Cloned " << branches.size() << " branch(es) sharing objects with " << remote.path(OBJECTS_DIR)
+                  << " in " << elapsed.count() << " ms." << std::endl;
+    } else if (blobless || depth > 0) {
+        std::cout << "Cloned " << copied << (blobless ? " commit(s)" : " object(s)") << " and " << branches.size()
+                  << " branch(es) in " << elapsed.count() << " ms";
+        if (blobless) std::cout << "; blobs will be fetched from the promisor on demand";
+        if (depth > 0) std::cout << "; history is cut at depth " << depth;
+        std::cout << "." << std::endl;
+    } else {
+        std::cout << "Cloned " << (linked + copied) << " object files (" << linked << " hardlinked, " << copied
+                  << " copied) and " << branches.size() << " branch(es) in " << elapsed.count() << " ms." << std::endl;
+    }
+    if (getHeadCommitHash().empty()) return true; // Empty repository: nothing to check out
+    return switchTo(head);
+}
+
+// Fetches every branch of another repository into remote-tracking refs
+// (origin/<branch>). The remote advertises its branch tips; tips we lack are
+// "wants". We then offer our own history newest first, NEGOTIATION_BATCH
+// commits per round, and the remote acknowledges commits it has; a chain
+// stops at its first acknowledged commit, since everything behind it is
+// common too. Only objects beyond the common commits are copied, into one pack.
+// In a shallow repository, `deepen` > 0 also extends history below each
+// shallow commit by that many commits, and a negative value fetches all of it.
+bool MiniGit::fetch(const std::string& remoteName, long deepen) {
+    if (!fileExists(MINIGIT_DIR)) {
+        std::cerr << "Error: Not a MiniGit repository. Run 'minigit init' first." << std::endl;
+        return false;
+    }
+    std::string path = remotePath(remoteName);
+    if (path.empty()) {
+        std::cerr << "Error: No remote given and this repository was not cloned from one." << std::endl;
+        return false;
+    }
+    RemoteRepository remote(path);
+    if (!remote.isRepository()) {
+        std::cerr << "Error: '" << path << "' is not a MiniGit repository." << std::endl;
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    std::map<std::string, std::string> advertised = remote.branches();
+    std::vector<std::string> wants;
+    std::unordered_set<std::string> wanted;
+    for (const auto& ref : advertised) {
+        if (!ref.second.empty() && !hasObject(ref.second) && wanted.insert(ref.second).second) wants.push_back(ref.second);
+    }
+
+    std::unordered_set<std::string> common;
+    size_t rounds = 0;
+    std::vector<std::string> cursors = wants.empty() ? std::vector<std::string>() : getRefTips();
+    std::unordered_set<std::string> offered;
+    while (!cursors.empty()) {
+        ++rounds;
+        std::vector<std::vector<std::string>> haves(cursors.size());
+        size_t count = 0;
+        for (bool progress = true; progress && count < NEGOTIATION_BATCH;) {
+            progress = false;
+            for (size_t i = 0; i < cursors.size() && count < NEGOTIATION_BATCH; ++i) {
+                std::string& next = cursors[i];
+                if (next.empty()) continue;
+                if (!offered.insert(next).second) {
+                    next.clear(); // Joined history another chain has already offered
+                    continue;
+                }
+                haves[i].push_back(next);
+                ++count;
+                next = readCommit(next).parentHash;
+                progress = true;
+            }
+        }
+        std::vector<std::string> remaining;
+        for (size_t i = 0; i < cursors.size(); ++i) {
+            bool acknowledged = false;
+            for (const std::string& have : haves[i]) {
+                if (remote.hasObject(have)) {
+                    common.insert(have);
+                    acknowledged = true;
+                    break;
+                }
+            }
+            if (!acknowledged && !cursors[i].empty()) remaining.push_back(cursors[i]);
+        }
+        cursors.swap(remaining);
+    }
+
+    // A partial clone fetching from its promisor keeps leaving blobs behind.
+    std::error_code ec;
+    bool blobless = fileExists(PROMISOR_FILE) && fs::equivalent(promisorPath(), path, ec);
+    auto readRemote = [&](const std::string& hash) { return remote.readObject(hash); };
+    // History may end early only at the remote's own shallow commits, which
+    // then become shallow here too; any other commit it lacks is an error.
+    std::unordered_set<std::string> remoteShallow = remote.shallowCommits();
+    std::vector<std::string> cut, missing;
+    std::vector<std::string> objects =
+        objectsToSend(wants, common, readRemote, !blobless, 0, &cut, remoteShallow, &missing);
+
+    // Deepening: walk the remote's history below each shallow commit. Commits
+    // still cut off from their parents form the new shallow list.
+    isShallow("");
+    std::unordered_set<std::string> shallow = shallowCommits;
+    if (deepen != 0 && !shallowCommits.empty()) {
+        std::vector<std::string> parents;
+        for (const std::string& hash : shallowCommits) {
+            std::string parent = Commit::deserialize(readObject(hash)).parentHash;
+            if (!parent.empty()) parents.push_back(parent);
+        }
+        std::vector<std::string> newShallow;
+        std::vector<std::string> older =
+            objectsToSend(parents, {}, readRemote, !blobless, deepen > 0 ? static_cast<size_t>(deepen) : 0,
+                          &newShallow, remoteShallow, &missing);
+        objects.insert(objects.end(), older.begin(), older.end());
+        shallow = std::unordered_set<std::string>(newShallow.begin(), newShallow.end());
+    } else if (deepen != 0) {
+        std::cout << "Repository is not shallow; nothing to deepen." << std::endl;
+    }
+    if (!missing.empty()) {
+        std::cerr << "Error: " << path << " is missing commit " << missing.front()
+                  << " from the history of its branches; nothing was fetched." << std::endl;
+        return false;
+    }
+    for (const std::string& hash : cut) {
+        if (!hasObject(Commit::deserialize(remote.readObject(hash)).parentHash)) shallow.insert(hash);
+    }
+    size_t received = 0;
+    if (!objects.empty()) {
+        if (!createDirectory(PACK_DIR)) return false;
+        std::string tmpPath = PACK_DIR + "tmp-fetch-" + std::to_string(::getpid());
+        PackWriter writer(tmpPath);
+        if (!writer.isOpen()) {
+            std::cerr << "Error: Could not create pack file." << std::endl;
+            return false;
+        }
+        for (const std::string& hash : objects) {
+            if (writer.contains(hash) || hasObject(hash)) continue;
+            std::string content = remote.readObject(hash);
+            if (computeSimpleHash(content) != hash) {
+                std::cerr << "Error: Object " << hash << " is missing or corrupt in " << path << std::endl;
+                writer.finish();
+                removeFile(tmpPath);
+                return false;
+            }
+            if (!writer.add(hash, content)) {
+                std::cerr << "Error: Could not write pack file." << std::endl;
+                writer.finish();
+                removeFile(tmpPath);
+                return false;
+            }
+        }
+        received = writer.objectCount();
+        if (received > 0) {
+            if (installPack(writer, tmpPath).empty()) return false;
+        } else {
+            writer.finish();
+            removeFile(tmpPath);
+        }
+    }
+
+    // Refs are only written once everything they point to has arrived.
+    for (const std::string& want : wants) {
+        if (!hasObject(want)) {
+            std::cerr << "Error: Commit " << want << " did not arrive from " << path << "; no refs were updated."
+                      << std::endl;
+            return false;
+        }
+    }
+    if (shallow != shallowCommits && !writeShallow(shallow)) return false;
+
+    std::map<std::string, std::string> tracking = listRemoteRefs();
+    for (const auto& ref : advertised) {
+        if (ref.second.empty()) continue;
+        std::string name = "origin/" + ref.first;
+        std::string old = tracking.count(name) ? tracking[name] : "";
+        if (old == ref.second) continue;
+        if (!writeFile(REMOTES_DIR + name, ref.second + "\n")) return false;
+        std::cout << "   " << (old.empty() ? "[new branch]   " : old.substr(0, 7) + ".." + ref.second.substr(0, 7)) << "  "
+                  << ref.first << " -> " << name << std::endl;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cout << "Fetched " << received << " object(s) after " << rounds << " negotiation round(s), "
+              << common.size() << " common commit(s), in " << elapsed.count() << " ms." << std::endl;
+    return true;
+}
+
+// Pushes branches (the current one by default) to another repository. The
+// remote's advertised tips that we have are the common base; objects beyond
+// them that the remote lacks are written as one pack into its pack directory,
+// then each remote branch is moved with a compare-and-swap against the
+// advertised value. Non-fast-forward updates need `force`.
+bool MiniGit::push(const std::string& remoteName, const std::vector<std::string>& branchNames, bool force) {
+    if (!fileExists(MINIGIT_DIR)) {
+        std::cerr << "Error: Not a MiniGit repository. Run 'minigit init' first." << std::endl;
+        return false;
+    }
+    std::string path = remotePath(remoteName);
+    if (path.empty()) {
+        std::cerr << "Error: No remote given and this repository was not cloned from one." << std::endl;
+        return false;
+    }
+    RemoteRepository remote(path);
+    if (!remote.isRepository()) {
+        std::cerr << "Error: '" << path << "' is not a MiniGit repository." << std::endl;
+        return false;
+    }
+
+    std::vector<std::string> branches = branchNames;
+    if (branches.empty()) {
+        std::string head = readFile(HEAD_FILE);
+        if (head.rfind("ref: refs/heads/", 0) != 0) {
+            std::cerr << "Error: HEAD is detached; name the branch to push." << std::endl;
+            return false;
+        }
+        head = head.substr(16);
+        if (!head.empty() && head.back() == '\n') head.pop_back();
+        branches.push_back(head);
+    }
+
+    struct Update {
+        std::string branch, oldHash, newHash;
+    };
+    std::map<std::string, std::string> advertised = remote.branches();
+    std::vector<Update> updates;
+    bool ok = true;
+    for (const std::string& branch : branches) {
+        std::string local = resolveRevision(branch);
+        if (!fileExists(HEADS_DIR + branch) || local.empty()) {
+            std::cerr << "Error: Branch '" << branch << "' does not exist or has no commits." << std::endl;
+            ok = false;
+            continue;
+        }
+        std::string theirs = advertised.count(branch) ? advertised[branch] : "";
+        if (theirs == local) {
+            std::cout << "   " << branch << " is up to date." << std::endl;
+            continue;
+        }
+        if (!theirs.empty() && !force) {
+            bool fastForward = false;
+            for (std::string hash = local; !hash.empty() && !fastForward; hash = readCommit(hash).parentHash) {
+                fastForward = hash == theirs;
+            }
+            if (!fastForward) {
+                std::cerr << "Error: Rejected " << branch << " (non-fast-forward); fetch and merge first, or use --force."
+                          << std::endl;
+                ok = false;
+                continue;
+            }
+        }
+        updates.push_back({branch, theirs, local});
+    }
+    if (updates.empty()) return ok;
+
+    std::unordered_set<std::string> common;
+    for (const auto& ref : advertised) {
+        if (!ref.second.empty() && hasObject(ref.second)) common.insert(ref.second);
+    }
+    std::vector<std::string> wants;
+    for (const Update& update : updates) wants.push_back(update.newHash);
+    // From a shallow repository the walk ends at the shallow commits. The
+    // remote must already have what lies below them, or its new history
+    // would have a hole.
+    isShallow("");
+    std::vector<std::string> cut, missing;
+    std::vector<std::string> objects = objectsToSend(
+        wants, common, [&](const std::string& hash) { return readObject(hash); }, true, 0, &cut, shallowCommits, &missing);
+    for (const std::string& hash : missing) {
+        std::cerr << "Error: Commit " << hash << " is missing from this repository; cannot push its history." << std::endl;
+        return false;
+    }
+    for (const std::string& hash : cut) {
+        std::string parent = Commit::deserialize(readObject(hash)).parentHash;
+        if (!remote.hasObject(parent)) {
+            std::cerr << "Error: This repository is shallow and " << path << " lacks commit " << parent
+                      << ", the parent of " << hash << "; fetch --unshallow first, or push from a full clone."
+                      << std::endl;
+            return false;
+        }
+    }
+
+    std::string packDir = remote.path(PACK_DIR);
+    if (!createDirectory(packDir)) return false;
+    std::string tmpPath = packDir + "tmp-push-" + std::to_string(::getpid());
+    PackWriter writer(tmpPath);
+    if (!writer.isOpen()) {
+        std::cerr << "Error: Could not create pack file in " << packDir << std::endl;
+        return false;
+    }
+    for (const std::string& hash : objects) {
+        if (writer.contains(hash) || remote.hasObject(hash)) continue;
+        if (!writer.add(hash, readObject(hash))) {
+            std::cerr << "Error: Could not write pack file in " << packDir << std::endl;
+            writer.finish();
+            removeFile(tmpPath);
+            return false;
+        }
+    }
+    size_t sent = writer.objectCount();
+    if (sent > 0) {
+        if (installPack(writer, tmpPath, packDir).empty()) return false;
+    } else {
+        writer.finish();
+        removeFile(tmpPath);
+    }
+
+    bool toOrigin = remoteName.empty() || remoteName == "origin" || path == remotePath("");
+    std::string remoteHead = remote.headBranch();
+    for (const Update& update : updates) {
+        RemoteRepository::RefUpdate result = remote.updateBranch(update.branch, update.oldHash, update.newHash);
+        if (result != RemoteRepository::RefUpdate::Updated) {
+            if (result == RemoteRepository::RefUpdate::Changed) {
+                std::cerr << "Error: " << update.branch << " changed in " << path
+                          << " during the push; fetch and try again." << std::endl;
+            } else if (result == RemoteRepository::RefUpdate::Locked) {
+                std::cerr << "Error: " << update.branch << " is being updated in " << path << " ("
+                          << HEADS_DIR << update.branch << ".lock exists); try again." << std::endl;
+            } else {
+                std::cerr << "Error: Could not update " << update.branch << " in " << path << "." << std::endl;
+            }
+            ok = false;
+            continue;
+        }
+        std::cout << "   " << (update.oldHash.empty() ? "[new branch]   " : update.oldHash.substr(0, 7) + ".." + update.newHash.substr(0, 7))
+                  << "  " << update.branch << " -> " << update.branch << std::endl;
+        if (update.branch == remoteHead) {
+            std::cout << "   Note: " << update.branch << " is checked out in " << path
+                      << "; its working files were not updated." << std::endl;
+        }
+        if (toOrigin) writeFile(REMOTES_DIR + "origin/" + update.branch, update.newHash + "\n");
+    }
+    std::cout << "Pushed " << sent << " object(s)." << std::endl;
+    return ok;
+}
+
+// Writes the commits selected by `revisions` (e.g. "master", "v1..master",
+// "^old master") and their blobs to a bundle file ("-" for stdout). Included
+// names become the bundle's refs; parents of the oldest selected commits
+// become its prerequisites. Objects are copied from storage in chunks, so the
+// bundle is never held in memory.
+bool MiniGit::createBundle(const std::string& file, const std::vector<std::string>& revisions) {
+    if (!fileExists(MINIGIT_DIR)) {
+        std::cerr << "Error: Not a MiniGit repository. Run 'minigit init' first." << std::endl;
+        return false;
+    }
+    std::vector<std::string> commits;
+    if (!listRevisions(revisions, commits)) return false;
+    if (commits.empty()) {
+        std::cerr << "Error: Refusing to create an empty bundle." << std::endl;
+        return false;
+    }
+
+    RevisionRange range;
+    parseRevisionArgs(revisions, range);
+    BundleHeader header;
+    std::vector<std::string> wants;
+    std::set<std::string> selected(commits.begin(), commits.end());
+    for (const std::string& rev : range.include) {
+        std::string hash = resolveRevision(rev);
+        if (!selected.count(hash)) continue; // Entirely excluded
+        std::string ref = fileExists(HEADS_DIR + rev) ? "refs/heads/" + rev : rev;
+        header.refs.emplace_back(hash, ref);
+        wants.push_back(hash);
+    }
+    std::unordered_set<std::string> prerequisites;
+    for (const std::string& hash : commits) {
+        std::string parent = readCommit(hash).parentHash;
+        if (!parent.empty() && !selected.count(parent) && prerequisites.insert(parent).second) {
+            header.prerequisites.push_back(parent);
+        }
+    }
+    std::vector<std::string> objects =
+        objectsToSend(wants, prerequisites, [&](const std::string& hash) { return readObject(hash); });
+
+    bool toStdout = file == "-";
+    int fd = toStdout ? STDOUT_FILENO : ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: Could not create " << file << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    bool ok = true;
+    unsigned long long bytes = 0;
+    {
+        OutputBuffer out(fd);
+        out << header.serialize();
+        for (const std::string& hash : objects) {
+            ObjectStream object;
+            if (!openObject(hash, object)) {
+                std::cerr << "Error: Missing object " << hash << std::endl;
+                ok = false;
+                break;
+            }
+            out << hash << ' ' << std::to_string(object.size()) << '\n';
+            bytes += object.size();
+            if (!object.copyTo(out)) {
+                std::cerr << "Error: Could not read object " << hash << std::endl;
+                ok = false;
+                break;
+            }
+        }
+        out.flush();
+        if (out.closed()) {
+            std::cerr << "Error: Could not write " << file << std::endl;
+            ok = false;
+        }
+    }
+    if (!toStdout) {
+        ::close(fd);
+        if (!ok) removeFile(file);
+    }
+    if (ok) {
+        std::cerr << "Bundled " << commits.size() << " commit(s), " << objects.size() << " object(s) (" << bytes
+                  << " bytes), " << header.refs.size() << " ref(s), " << header.prerequisites.size()
+                  << " prerequisite(s)." << std::endl;
+    }
+    return ok;
+}
+
+// Checks that this repository has every prerequisite commit of a bundle.
+bool MiniGit::verifyBundle(const std::string& file) {
+    std::ifstream in(file, std::ios::binary);
+    BundleHeader header;
+    if (!in.is_open() || !BundleHeader::read(in, header)) {
+        std::cerr << "Error: '" << file << "' is not a MiniGit bundle." << std::endl;
+        return false;
+    }
+    bool ok = true;
+    for (const std::string& hash : header.prerequisites) {
+        if (!hasObject(hash)) {
+            std::cerr << "Error: Missing prerequisite commit " << hash << std::endl;
+            ok = false;
+        }
+    }
+    if (ok) {
+        for (const auto& ref : header.refs) std::cout << ref.first << " " << ref.second << std::endl;
+        std::cout << file << " is okay (" << header.prerequisites.size() << " prerequisite(s))." << std::endl;
+    }
+    return ok;
+}
+
+// Verifies a bundle's prerequisites, then reads its object records one at a
+// time, checks each against its hash and writes the new ones into a pack,
+// indexing it as it goes. The bundle's branches are recorded as
+// remote-tracking refs bundle/<branch>, ready to merge or check out.
+bool MiniGit::unbundle(const std::string& file) {
+    if (!fileExists(MINIGIT_DIR)) {
+        std::cerr << "Error: Not a MiniGit repository. Run 'minigit init' first." << std::endl;
+        return false;
+    }
+    std::ifstream in(file, std::ios::binary);
+    BundleHeader header;
+    if (!in.is_open() || !BundleHeader::read(in, header)) {
+        std::cerr << "Error: '" << file << "' is not a MiniGit bundle." << std::endl;
+        return false;
+    }
+    for (const auto& ref : header.refs) {
+        std::string name = ref.second.rfind("refs/heads/", 0) == 0 ? ref.second.substr(11) : ref.second;
+        if (!BundleHeader::isSafeRefName(name)) {
+            std::cerr << "Error: Bundle has an invalid ref name '" << ref.second << "'." << std::endl;
+            return false;
+        }
+    }
+    for (const std::string& hash : header.prerequisites) {
+        if (!hasObject(hash)) {
+            std::cerr << "Error: Missing prerequisite commit " << hash << "; fetch the history it builds on first."
+                      << std::endl;
+            return false;
+        }
+    }
+
+    if (!createDirectory(PACK_DIR)) return false;
+    std::string tmpPath = PACK_DIR + "tmp-bundle-" + std::to_string(::getpid());
+    PackWriter writer(tmpPath);
+    if (!writer.isOpen()) {
+        std::cerr << "Error: Could not create pack file." << std::endl;
+        return false;
+    }
+    auto fail = [&](const std::string& message) {
+        std::cerr << "Error: " << message << std::endl;
+        writer.finish();
+        removeFile(tmpPath);
+        return false;
+    };
+    std::error_code ec;
+    unsigned long long fileSize = fs::file_size(file, ec);
+    if (ec) return fail("Could not read " + file + ": " + ec.message());
+    size_t records = 0;
+    std::string line, content;
+    while (std::getline(in, line)) {
+        size_t space = line.find(' ');
+        if (space == std::string::npos) return fail("Malformed object record in bundle: " + line);
+        std::string hash = line.substr(0, space);
+        unsigned long long length;
+        if (!parseDecimal(line.substr(space + 1), length)) return fail("Malformed object record in bundle: " + line);
+        // Checked before allocating: a corrupt length must not size the buffer.
+        std::streamoff position = in.tellg();
+        if (position < 0 || length > fileSize - static_cast<unsigned long long>(position)) {
+            return fail("Bundle is truncated in object " + hash);
+        }
+        content.resize(static_cast<size_t>(length));
+        if (length > 0 && !in.read(&content[0], static_cast<std::streamsize>(length))) {
+            return fail("Bundle is truncated in object " + hash);
+        }
+        if (computeSimpleHash(content) != hash) return fail("Object " + hash + " in bundle is corrupt");
+        ++records;
+        if (writer.contains(hash) || hasObject(hash)) continue;
+        if (!writer.add(hash, content)) return fail("Could not write pack file.");
+    }
+    for (const auto& ref : header.refs) {
+        if (!writer.contains(ref.first) && !hasObject(ref.first)) {
+            return fail("Bundle is missing the commit for " + ref.second);
+        }
+    }
+    size_t added = writer.objectCount();
+    if (added > 0) {
+        if (installPack(writer, tmpPath).empty()) return false;
+    } else {
+        writer.finish();
+        removeFile(tmpPath);
+    }
+
+    for (const auto& ref : header.refs) {
+        std::string name = ref.second.rfind("refs/heads/", 0) == 0 ? ref.second.substr(11) : ref.second;
+        if (name.find_first_of("~^") != std::string::npos) continue; // Not a branch name
+        if (!writeFile(REMOTES_DIR + "bundle/" + name, ref.first + "\n")) return false;
+        std::cout << "   " << ref.first.substr(0, 7) << "  " << ref.second << " -> bundle/" << name << std::endl;
+    }
+    std::cout << "Unbundled " << records << " object(s), " << added << " new." << std::endl;
+    return true;
+}
@@ -0,0 +1,117 @@
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include <cstdlib>
+
+// Size-bounded LRU cache of object contents, consulted by every object read.
+// Objects are immutable, so entries never go stale; once the cached bytes
+// exceed the budget the least recently used ones are evicted. Keys are the
+// binary value of the 16-digit hex hash; objects larger than an eighth of the
+// budget are not cached, so one big blob can't flush everything else.
+class ObjectCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t budget = 0;
+    };
+
+    explicit ObjectCache(size_t budget) : budget(budget) {}
+
+    bool get(const std::string& hash, std::string& content) {
+        uint64_t k;
+        if (!key(hash, k)) return false;
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = index.find(k);
+        if (it == index.end()) {
+            ++counters.misses;
+            return false;
+        }
+        ++counters.hits;
+        lru.splice(lru.begin(), lru, it->second);
+        content = it->second->content;
+        return true;
+    }
+
+    void put(const std::string& hash, const std::string& content) {
+        uint64_t k;
+        if (!key(hash, k) || cost(content) > budget / 8) return;
+        std::lock_guard<std::mutex> guard(lock);
+        if (index.count(k)) return;
+        lru.push_front({k, content});
+        index[k] = lru.begin();
+        bytes += cost(content);
+        while (bytes > budget && !lru.empty()) {
+            bytes -= cost(lru.back().content);
+            index.erase(lru.back().key);
+            lru.pop_back();
+            ++counters.evictions;
+        }
+    }
+
+    // Drops every entry, e.g. after gc deleted objects that may be cached.
+    void clear() {
+        std::lock_guard<std::mutex> guard(lock);
+        lru.clear();
+        index.clear();
+        bytes = 0;
+    }
+
+    Stats stats() {
+        std::lock_guard<std::mutex> guard(lock);
+        Stats result = counters;
+        result.entries = index.size();
+        result.bytes = bytes;
+        result.budget = budget;
+        return result;
+    }
+
+    // Budget from `variable` ("<n>[k|m|g]" bytes; 0 disables caching), or
+    // `fallback` if it isn't set or isn't a number.
+    static size_t budgetFromEnvironment(const char* variable, size_t fallback) {
+        const char* value = std::getenv(variable);
+        if (!value || !*value) return fallback;
+        char* end;
+        unsigned long long size = std::strtoull(value, &end, 10);
+        if (end == value) return fallback;
+        switch (*end) {
+        case 'g': case 'G': size <<= 10; // Fall through
+        case 'm': case 'M': size <<= 10; // Fall through
+        case 'k': case 'K': size <<= 10; ++end; break;
+        default: break;
+        }
+        return *end ? fallback : static_cast<size_t>(size);
+    }
+
+private:
+    struct Entry {
+        uint64_t key;
+        std::string content;
+    };
+
+    static bool key(const std::string& hash, uint64_t& k) {
+        if (hash.size() != 16) return false;
+        k = 0;
+        for (char c : hash) {
+            int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+            if (digit < 0) return false;
+            k = (k << 4) | static_cast<uint64_t>(digit);
+        }
+        return true;
+    }
+
+    // Bytes charged against the budget, including list and map bookkeeping.
+    static size_t cost(const std::string& content) { return content.size() + 96; }
+
+    std::list<Entry> lru; // Most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+    size_t budget;
+    size_t bytes = 0;
+    Stats counters;
+    std::mutex lock;
+};
@@ -0,0 +1,67 @@
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Bloom filter over the hashes of every stored object. A negative answer
+// means the object is definitely absent, so "do we have it?" is answered
+// without touching the filesystem; a positive one still has to be confirmed.
+// Sized at 10 bits per object (about 1% false positives) for twice the count
+// it was built with; past that, add() only raises the false-positive rate,
+// and full() tells the owner to rebuild it.
+class ObjectFilter {
+public:
+    static const unsigned BITS_PER_OBJECT = 10;
+    static const unsigned NUM_HASHES = 7;
+
+    void reset(size_t expected) {
+        capacity = std::max<size_t>(expected * 2, 1024);
+        bits.assign((capacity * BITS_PER_OBJECT + 63) / 64, 0);
+        count = 0;
+    }
+
+    void add(const std::string& hash) {
+        uint64_t h1, h2;
+        hashes(hash, h1, h2);
+        uint64_t nbits = bits.size() * 64;
+        for (unsigned i = 0; i < NUM_HASHES; ++i) {
+            uint64_t bit = (h1 + i * h2) % nbits;
+            bits[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+        ++count;
+    }
+
+    bool mightContain(const std::string& hash) const {
+        if (bits.empty()) return true; // Not built: cannot rule anything out
+        uint64_t h1, h2;
+        hashes(hash, h1, h2);
+        uint64_t nbits = bits.size() * 64;
+        for (unsigned i = 0; i < NUM_HASHES; ++i) {
+            uint64_t bit = (h1 + i * h2) % nbits;
+            if (!(bits[bit / 64] & (uint64_t(1) << (bit % 64)))) return false;
+        }
+        return true;
+    }
+
+    bool full() const { return count > capacity; }
+
+private:
+    // Object hashes are djb2 values, whose low bits are poorly mixed, so the
+    // hash text is folded with FNV-1a and spread with splitmix64 finalizers.
+    static void hashes(const std::string& hash, uint64_t& h1, uint64_t& h2) {
+        uint64_t h = 1469598103934665603ULL;
+        for (unsigned char c : hash) h = (h ^ c) * 1099511628211ULL;
+        h1 = mix(h);
+        h2 = mix(h1) | 1; // Odd, so the probes don't repeat early
+    }
+
+    static uint64_t mix(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    std::vector<uint64_t> bits;
+    size_t capacity = 0;
+    size_t count = 0;
+};
@@ -0,0 +1,66 @@
+#include <string>
+#include <cerrno>
+#include <unistd.h> // For write()
+
+// Buffered writer for command output that goes to stdout.
+// Unlike std::cout with std::endl, it only issues a write() when the buffer
+// fills up (or on flush), and it remembers when the reader has gone away
+// (EPIPE) so callers can stop producing output early, e.g. `minigit log | head`.
+class OutputBuffer {
+public:
+    explicit OutputBuffer(int fd = STDOUT_FILENO, size_t capacity = 64 * 1024)
+        : fd(fd), capacity(capacity), broken(false) {
+        buffer.reserve(capacity);
+    }
+    ~OutputBuffer() { flush(); }
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    void append(const char* data, size_t len) {
+        if (broken) return;
+        if (buffer.size() + len > capacity) {
+            flush();
+            if (len >= capacity) {
+                writeAll(data, len);
+                return;
+            }
+        }
+        buffer.append(data, len);
+    }
+    void append(const std::string& s) { append(s.data(), s.size()); }
+    void append(char c) { append(&c, 1); }
+
+    OutputBuffer& operator<<(const std::string& s) { append(s); return *this; }
+    OutputBuffer& operator<<(const char* s) { append(std::string(s)); return *this; }
+    OutputBuffer& operator<<(char c) { append(c); return *this; }
+
+    void flush() {
+        if (!buffer.empty()) {
+            writeAll(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+
+    // True once the other end of the pipe has been closed.
+    bool closed() const { return broken; }
+
+private:
+    void writeAll(const char* data, size_t len) {
+        while (len > 0 && !broken) {
+            ssize_t n = ::write(fd, data, len);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                broken = true; // EPIPE or any other write error: stop producing output
+                return;
+            }
+            data += n;
+            len -= static_cast<size_t>(n);
+        }
+    }
+
+    int fd;
+    size_t capacity;
+    bool broken;
+    std::string buffer;
+};
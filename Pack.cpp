@@ -0,0 +1,351 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cerrno>
+
+// A pack stores many objects back to back in one file (pack-<id>.pack), with
+// an index (pack-<id>.idx) listing "<hash> <offset> <length>" sorted by hash,
+// so one open file replaces thousands of loose objects.
+class PackIndex {
+public:
+    struct Entry {
+        std::string hash;
+        unsigned long long offset;
+        unsigned long long length;
+    };
+
+    static const char* header() { return "minigit-pack-index 1"; }
+
+    std::string packPath; // Path of the .pack file this index describes
+
+    static PackIndex deserialize(const std::string& data, const std::string& packPath) {
+        PackIndex index;
+        index.packPath = packPath;
+        std::stringstream ss(data);
+        std::string line;
+        if (!std::getline(ss, line) || line != header()) return index;
+        Entry entry;
+        while (ss >> entry.hash >> entry.offset >> entry.length) {
+            index.entries.push_back(entry);
+        }
+        if (!std::is_sorted(index.entries.begin(), index.entries.end(), byHash)) {
+            std::sort(index.entries.begin(), index.entries.end(), byHash);
+        }
+        return index;
+    }
+
+    std::string serialize() const {
+        std::string out = std::string(header()) + "\n";
+        for (const Entry& entry : entries) {
+            out += entry.hash + " " + std::to_string(entry.offset) + " " + std::to_string(entry.length) + "\n";
+        }
+        return out;
+    }
+
+    const Entry* find(const std::string& hash) const {
+        auto it = std::lower_bound(entries.begin(), entries.end(), hash,
+                                   [](const Entry& e, const std::string& h) { return e.hash < h; });
+        return (it != entries.end() && it->hash == hash) ? &*it : nullptr;
+    }
+
+    // Reads one object's bytes straight from the pack file.
+    bool read(const Entry& entry, std::string& content) const {
+        return FileIO::readAt(packPath, entry.offset, static_cast<size_t>(entry.length), content) == 0;
+    }
+
+    const std::vector<Entry>& all() const { return entries; }
+
+    void add(const std::string& hash, unsigned long long offset, unsigned long long length) {
+        entries.push_back({hash, offset, length});
+    }
+    void sort() { std::sort(entries.begin(), entries.end(), byHash); }
+
+private:
+    static bool byHash(const Entry& a, const Entry& b) { return a.hash < b.hash; }
+
+    std::vector<Entry> entries;
+};
+
+// Streams objects into a new pack file; finish() writes the matching index.
+// The pack is written under a temporary name and renamed into place by the
+// caller once complete, so readers never see a half-written pack.
+class PackWriter {
+public:
+    explicit PackWriter(const std::string& path) : path(path), out(path, std::ios::binary | std::ios::trunc), offset(0) {
+        index.packPath = path;
+    }
+
+    bool isOpen() const { return out.is_open(); }
+
+    bool add(const std::string& hash, const std::string& content) {
+        if (!out.write(content.data(), static_cast<std::streamsize>(content.size()))) return false;
+        index.add(hash, offset, content.size());
+        locations[hash] = {offset, content.size()};
+        offset += content.size();
+        return true;
+    }
+
+    bool contains(const std::string& hash) const { return locations.count(hash) > 0; }
+
+    // Reads back an object already added to this (unfinished) pack.
+    bool read(const std::string& hash, std::string& content) {
+        auto it = locations.find(hash);
+        if (it == locations.end()) return false;
+        out.flush();
+        return FileIO::readAt(path, it->second.first, static_cast<size_t>(it->second.second), content) == 0;
+    }
+
+    size_t objectCount() const { return index.all().size(); }
+    unsigned long long bytesWritten() const { return offset; }
+
+    // Flushes the pack and returns its sorted index. Check complete() before
+    // installing it: a write or the final flush may have failed (e.g. ENOSPC).
+    PackIndex finish() {
+        out.close();
+        written = !out.fail();
+        index.sort();
+        return index;
+    }
+
+    bool complete() const { return written; }
+
+private:
+    std::string path;
+    std::ofstream out;
+    unsigned long long offset;
+    bool written = false;
+    PackIndex index;
+    std::unordered_map<std::string, std::pair<unsigned long long, unsigned long long>> locations;
+};
+
+// Sequential reader over one stored object, loose or packed, so large objects
+// can be copied out in chunks instead of being loaded whole.
+class ObjectStream {
+public:
+    bool open(const std::string& path, unsigned long long offset, unsigned long long length) {
+        file.open(path, std::ios::binary);
+        if (!file.is_open()) return false;
+        file.seekg(static_cast<std::streamoff>(offset));
+        objectSize = remaining = length;
+        return static_cast<bool>(file);
+    }
+
+    unsigned long long size() const { return objectSize; }
+
+    // Reads up to `max` bytes; returns 0 at the end of the object or on error.
+    size_t read(char* data, size_t max) {
+        size_t want = static_cast<size_t>(std::min<unsigned long long>(max, remaining));
+        if (want == 0 || !file.read(data, static_cast<std::streamsize>(want))) return 0;
+        remaining -= want;
+        return want;
+    }
+
+    // Copies the rest of the object to `out`. Returns false if it was cut short.
+    bool copyTo(OutputBuffer& out) {
+        char chunk[64 * 1024];
+        while (remaining > 0 && !out.closed()) {
+            size_t n = read(chunk, sizeof(chunk));
+            if (n == 0) return false;
+            out.append(chunk, n);
+        }
+        return remaining == 0;
+    }
+
+private:
+    std::ifstream file;
+    unsigned long long objectSize = 0;
+    unsigned long long remaining = 0;
+};
+
+// Multi-pack index (PACK_DIR/multi-pack-index): one table of every object in
+// a set of packs, sorted by hash, so a lookup is a single binary search no
+// matter how many packs there are. Records have a fixed width, so the file is
+// memory-mapped and searched in place without being parsed:
+//   minigit-multi-pack-index 1
+//   packs <count>
+//   <pack file name>                     one line per pack; pack ids count from 0
+//   objects <count>
+//   <hash> <pack id> <offset> <length>   16, 4, 16 and 16 hex digits
+class MultiPackIndex {
+public:
+    struct Record {
+        std::string hash;
+        unsigned packId;
+        unsigned long long offset;
+        unsigned long long length;
+    };
+
+    static const char* header() { return "minigit-multi-pack-index 1"; }
+    static constexpr size_t HASH_WIDTH = 16;
+    static constexpr size_t RECORD_SIZE = HASH_WIDTH + 1 + 4 + 1 + 16 + 1 + 16 + 1;
+
+    // Maps the index at `path`; pack names are resolved relative to `packDir`.
+    bool open(const std::string& path, const std::string& packDir) {
+        close();
+        if (file.open(path) != 0) return false;
+        data = file.data();
+        size = file.size();
+        if (!parseHeader(packDir)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        file.close();
+        data = nullptr;
+        size = 0;
+        count = 0;
+        packNames.clear();
+        packPaths.clear();
+    }
+
+    bool isOpen() const { return data != nullptr; }
+    size_t objectCount() const { return count; }
+    const std::vector<std::string>& packs() const { return packNames; }
+
+    // Finds `hash`; `packPath` then names the pack file holding it.
+    bool find(const std::string& hash, const std::string*& packPath, unsigned long long& offset,
+              unsigned long long& length) const {
+        if (hash.size() != HASH_WIDTH) return false;
+        size_t pos = lowerBound(hash);
+        if (pos >= count || std::memcmp(recordAt(pos), hash.data(), HASH_WIDTH) != 0) return false;
+        Record record = decode(pos);
+        if (record.packId >= packPaths.size()) return false; // Corrupt record
+        packPath = &packPaths[record.packId];
+        offset = record.offset;
+        length = record.length;
+        return true;
+    }
+
+    // Hashes starting with `prefix`, for abbreviated revisions.
+    std::vector<std::string> withPrefix(const std::string& prefix) const {
+        std::vector<std::string> matches;
+        for (size_t pos = lowerBound(prefix); pos < count; ++pos) {
+            if (std::memcmp(recordAt(pos), prefix.data(), std::min(prefix.size(), HASH_WIDTH)) != 0) break;
+            matches.emplace_back(recordAt(pos), HASH_WIDTH);
+        }
+        return matches;
+    }
+
+    std::string hashAt(size_t pos) const { return std::string(recordAt(pos), HASH_WIDTH); }
+
+    std::vector<Record> records() const {
+        std::vector<Record> all;
+        all.reserve(count);
+        for (size_t pos = 0; pos < count; ++pos) {
+            Record record = decode(pos);
+            if (record.packId < packPaths.size()) all.push_back(std::move(record)); // Drop corrupt records
+        }
+        return all;
+    }
+
+    // Builds the file for `names` (pack ids are positions in it). `records`
+    // must be sorted by hash; duplicates keep their first record. Returns ""
+    // if a hash doesn't fit the fixed record width.
+    static std::string serialize(const std::vector<std::string>& names, const std::vector<Record>& records) {
+        for (const Record& record : records) {
+            if (record.hash.size() != HASH_WIDTH) return "";
+        }
+        std::string out = std::string(header()) + "\npacks " + std::to_string(names.size()) + "\n";
+        for (const std::string& name : names) out += name + "\n";
+        std::string body;
+        body.reserve(records.size() * RECORD_SIZE);
+        size_t written = 0;
+        char line[RECORD_SIZE + 1];
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (i > 0 && records[i].hash == records[i - 1].hash) continue;
+            std::snprintf(line, sizeof(line), "%s %04x %016llx %016llx\n", records[i].hash.c_str(), records[i].packId,
+                          records[i].offset, records[i].length);
+            body.append(line, RECORD_SIZE);
+            ++written;
+        }
+        return out + "objects " + std::to_string(written) + "\n" + body;
+    }
+
+    static bool byHash(const Record& a, const Record& b) { return a.hash < b.hash; }
+
+private:
+    bool parseHeader(const std::string& packDir) {
+        size_t pos = 0;
+        auto nextLine = [&](std::string& line) {
+            const char* end = static_cast<const char*>(std::memchr(data + pos, '\n', size - pos));
+            if (!end) return false;
+            line.assign(data + pos, end);
+            pos = static_cast<size_t>(end - data) + 1;
+            return true;
+        };
+        std::string line;
+        if (!nextLine(line) || line != header()) return false;
+        size_t packCount;
+        if (!nextLine(line) || line.rfind("packs ", 0) != 0 || !parseCount(line.substr(6), packCount)) return false;
+        if (packCount > 0xffff) return false; // Pack ids are 4 hex digits
+        for (size_t i = 0; i < packCount; ++i) {
+            if (!nextLine(line)) return false;
+            packNames.push_back(line);
+            packPaths.push_back(packDir + line);
+        }
+        if (!nextLine(line) || line.rfind("objects ", 0) != 0 || !parseCount(line.substr(8), count)) return false;
+        records_ = data + pos;
+        return (size - pos) % RECORD_SIZE == 0 && (size - pos) / RECORD_SIZE == count;
+    }
+
+    // A count in the header. Anything but plain digits in range makes the
+    // whole index unreadable, and it is then treated as stale.
+    static bool parseCount(const std::string& text, size_t& value) {
+        if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) return false;
+        errno = 0;
+        unsigned long long parsed = std::strtoull(text.c_str(), nullptr, 10);
+        if (errno == ERANGE || parsed > SIZE_MAX) return false;
+        value = static_cast<size_t>(parsed);
+        return true;
+    }
+
+    const char* recordAt(size_t pos) const { return records_ + pos * RECORD_SIZE; }
+
+    size_t lowerBound(const std::string& key) const {
+        size_t low = 0, high = count;
+        size_t width = std::min(key.size(), HASH_WIDTH);
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            if (std::memcmp(recordAt(mid), key.data(), width) < 0) low = mid + 1;
+            else high = mid;
+        }
+        return low;
+    }
+
+    Record decode(size_t pos) const {
+        const char* r = recordAt(pos);
+        Record record;
+        record.hash.assign(r, HASH_WIDTH);
+        record.packId = static_cast<unsigned>(hexValue(r + 17, 4));
+        record.offset = hexValue(r + 22, 16);
+        record.length = hexValue(r + 39, 16);
+        return record;
+    }
+
+    static unsigned long long hexValue(const char* digits, size_t width) {
+        unsigned long long value = 0;
+        for (size_t i = 0; i < width; ++i) {
+            char c = digits[i];
+            value = (value << 4) | static_cast<unsigned>(c <= '9' ? c - '0' : c - 'a' + 10);
+        }
+        return value;
+    }
+
+    MappedFile file;
+    const char* data = nullptr;
+    const char* records_ = nullptr;
+    size_t size = 0;
+    size_t count = 0;
+    std::vector<std::string> packNames;
+    std::vector<std::string> packPaths;
+};
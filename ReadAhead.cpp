@@ -0,0 +1,85 @@
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Background thread that asks the kernel to start reading object data a
+// command will need soon (posix_fadvise WILLNEED), so the synchronous read
+// later finds it in the page cache. Opening a cold loose object is itself a
+// disk access, which is why the hints are issued off the caller's thread.
+// Hints are best effort: files that don't exist are skipped, and hints still
+// queued when the owner goes away are dropped.
+class ReadAhead {
+public:
+    struct Range {
+        std::string path;
+        unsigned long long offset;
+        unsigned long long length; // 0 means the whole file
+    };
+
+    ReadAhead() = default;
+    ReadAhead(const ReadAhead&) = delete;
+    ReadAhead& operator=(const ReadAhead&) = delete;
+    ~ReadAhead() { stop(); }
+
+    void hint(const std::vector<Range>& ranges) {
+        if (ranges.empty()) return;
+        std::lock_guard<std::mutex> guard(lock);
+        if (!worker.joinable()) {
+            stopping = false;
+            worker = std::thread([this]() { run(); });
+        }
+        queue.insert(queue.end(), ranges.begin(), ranges.end());
+        wake.notify_one();
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!worker.joinable()) return;
+            stopping = true;
+            queue.clear();
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+private:
+    void run() {
+        std::string openPath; // Consecutive ranges of one pack share a descriptor
+        int fd = -1;
+        for (;;) {
+            Range range;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                if (queue.empty() && fd >= 0) {
+                    ::close(fd); // Don't hold a pack open while idle
+                    fd = -1;
+                    openPath.clear();
+                }
+                wake.wait(guard, [this]() { return stopping || !queue.empty(); });
+                if (stopping) break;
+                range = std::move(queue.front());
+                queue.pop_front();
+            }
+            if (range.path != openPath) {
+                if (fd >= 0) ::close(fd);
+                fd = ::open(range.path.c_str(), O_RDONLY | O_CLOEXEC);
+                openPath = fd >= 0 ? range.path : "";
+            }
+            if (fd < 0) continue;
+            ::posix_fadvise(fd, static_cast<off_t>(range.offset), static_cast<off_t>(range.length), POSIX_FADV_WILLNEED);
+        }
+        if (fd >= 0) ::close(fd);
+    }
+
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<Range> queue;
+    bool stopping = false;
+};
@@ -0,0 +1,268 @@
+#include <string>
+#include <map>
+#include <vector>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <unordered_set>
+#include <sstream>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Another repository reached through the filesystem (a sibling checkout or a
+// shared mount), used by clone, fetch and push. Paths are the usual layout
+// below `root`; the remote is read and written directly, with no helper
+// process on the other side.
+class RemoteRepository {
+public:
+    // Partial clones of partial clones are read through a chain of promisors;
+    // this bounds it, in case promisor files point at each other.
+    static const size_t MAX_PROMISOR_HOPS = 8;
+
+    explicit RemoteRepository(const std::string& path, size_t hops = 0)
+        : root(path.empty() || path.back() == '/' ? path : path + "/"), hops(hops) {}
+
+    bool isRepository() const {
+        std::error_code ec;
+        return fs::is_directory(root + MINIGIT_DIR, ec);
+    }
+
+    std::string path(const std::string& relative) const { return root + relative; }
+
+    // Ref advertisement: every branch and the commit it points to.
+    std::map<std::string, std::string> branches() const {
+        std::map<std::string, std::string> refs;
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator(root + HEADS_DIR, ec)) {
+            if (!entry.is_regular_file(ec)) continue;
+            std::string hash = readAll(entry.path().string());
+            if (!hash.empty() && hash.back() == '\n') hash.pop_back();
+            refs[entry.path().filename().string()] = hash;
+        }
+        return refs;
+    }
+
+    // Commits whose parents a shallow clone doesn't have; empty for a full repository.
+    std::unordered_set<std::string> shallowCommits() const {
+        std::unordered_set<std::string> commits;
+        std::stringstream list(readAll(root + SHALLOW_FILE));
+        std::string line;
+        while (std::getline(list, line)) {
+            if (!line.empty()) commits.insert(line);
+        }
+        return commits;
+    }
+
+    // Branch HEAD points to, or "" for a detached HEAD.
+    std::string headBranch() const {
+        std::string head = readAll(root + HEAD_FILE);
+        if (!head.empty() && head.back() == '\n') head.pop_back();
+        const std::string prefix = "ref: refs/heads/";
+        return head.rfind(prefix, 0) == 0 ? head.substr(prefix.size()) : "";
+    }
+
+    // Reads from the repository's own objects, then from the object
+    // directories its alternates file lists (a --shared clone keeps none of
+    // its own history), and finally, for a partial clone, from its promisor.
+    std::string readObject(const std::string& hash) {
+        std::string content = readStored(hash);
+        if (content.empty() && promisor()) content = promisor()->readObject(hash);
+        return content;
+    }
+
+    // True if the object is stored here or a promisor further along can supply it.
+    bool canSupply(const std::string& hash) { return hasObject(hash) || (promisor() && promisor()->canSupply(hash)); }
+
+    // The repository this one is a partial clone of, or "".
+    std::string promisorPath() const {
+        std::string path = readAll(root + PROMISOR_FILE);
+        if (!path.empty() && path.back() == '\n') path.pop_back();
+        return path;
+    }
+
+    bool hasObject(const std::string& hash) {
+        std::error_code ec;
+        if (fs::exists(root + OBJECTS_DIR + hash, ec)) return true;
+        loadStores();
+        for (size_t i = 0; i < stores.size(); ++i) {
+            if (i > 0 && fs::exists(stores[i].objectsDir + hash, ec)) return true;
+            for (const PackIndex& pack : stores[i].packs) {
+                if (pack.find(hash)) return true;
+            }
+        }
+        return false;
+    }
+
+    // The object directories listed in the repository's alternates file, as
+    // absolute paths ending in '/'. Relative entries are relative to its
+    // objects directory, as MiniGit::loadAlternates reads them.
+    std::vector<std::string> alternates() const {
+        std::vector<std::string> dirs;
+        std::stringstream list(readAll(root + ALTERNATES_FILE));
+        std::string line;
+        while (std::getline(list, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            std::error_code ec;
+            fs::path dir = fs::path(line).is_absolute() ? fs::path(line) : fs::path(root + OBJECTS_DIR) / line;
+            std::string resolved = fs::absolute(dir, ec).lexically_normal().string();
+            if (resolved.empty()) continue;
+            if (resolved.back() != '/') resolved += '/';
+            dirs.push_back(resolved);
+        }
+        return dirs;
+    }
+
+    enum class RefUpdate { Updated, Changed, Locked, Failed };
+
+    // Points `branch` at `hash` if it still points at `expected` (a
+    // compare-and-swap against the advertisement the push was planned from).
+    // The lock file is created exclusively and the ref is re-read while it is
+    // held, so of two concurrent pushes one wins and the other sees Locked or
+    // Changed instead of silently overwriting it.
+    RefUpdate updateBranch(const std::string& branch, const std::string& expected, const std::string& hash) {
+        TraceSpan span("updateRemoteBranch", "ref", branch);
+        std::string refPath = root + HEADS_DIR + branch;
+        std::string lockPath = refPath + ".lock";
+        int fd = ::open(lockPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd < 0) return errno == EEXIST ? RefUpdate::Locked : RefUpdate::Failed;
+        auto release = [&](RefUpdate result) {
+            ::unlink(lockPath.c_str());
+            return result;
+        };
+        std::string current = readAll(refPath);
+        if (!current.empty() && current.back() == '\n') current.pop_back();
+        if (current != expected) {
+            ::close(fd);
+            return release(RefUpdate::Changed);
+        }
+        std::string line = hash + "\n";
+        size_t done = 0;
+        while (done < line.size()) {
+            ssize_t n = ::write(fd, line.data() + done, line.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) break;
+            done += static_cast<size_t>(n);
+        }
+        if (::close(fd) != 0 || done < line.size()) return release(RefUpdate::Failed);
+        std::error_code ec;
+        fs::rename(lockPath, refPath, ec);
+        return ec ? release(RefUpdate::Failed) : RefUpdate::Updated;
+    }
+
+private:
+    static std::string readAll(const std::string& path) {
+        std::string content;
+        FileIO::read(path, content);
+        return content;
+    }
+
+    std::string readStored(const std::string& hash) {
+        std::string content = readAll(root + OBJECTS_DIR + hash);
+        if (!content.empty()) return content;
+        loadStores();
+        for (size_t i = 0; i < stores.size(); ++i) {
+            if (i > 0) {
+                content = readAll(stores[i].objectsDir + hash);
+                if (!content.empty()) return content;
+            }
+            for (const PackIndex& pack : stores[i].packs) {
+                if (const PackIndex::Entry* entry = pack.find(hash)) {
+                    pack.read(*entry, content);
+                    return content;
+                }
+            }
+        }
+        return "";
+    }
+
+    RemoteRepository* promisor() {
+        if (!promisorLoaded) {
+            promisorLoaded = true;
+            std::string path = promisorPath();
+            if (!path.empty() && hops < MAX_PROMISOR_HOPS) next = std::make_unique<RemoteRepository>(path, hops + 1);
+        }
+        return next.get();
+    }
+
+    struct Store {
+        std::string objectsDir;
+        std::vector<PackIndex> packs;
+    };
+
+    // The repository's own objects directory first, then its alternates.
+    void loadStores() {
+        if (storesLoaded) return;
+        storesLoaded = true;
+        stores.clear();
+        std::vector<std::string> dirs{root + OBJECTS_DIR};
+        for (const std::string& dir : alternates()) dirs.push_back(dir);
+        for (const std::string& dir : dirs) {
+            Store store{dir, {}};
+            std::error_code ec;
+            for (const auto& entry : fs::directory_iterator(dir + "pack/", ec)) {
+                std::string idxPath = entry.path().string();
+                if (entry.path().extension() != ".idx") continue;
+                store.packs.push_back(
+                    PackIndex::deserialize(readAll(idxPath), idxPath.substr(0, idxPath.size() - 4) + ".pack"));
+            }
+            stores.push_back(std::move(store));
+        }
+    }
+
+    std::string root;
+    size_t hops;
+    std::vector<Store> stores;
+    bool storesLoaded = false;
+    std::unique_ptr<RemoteRepository> next; // The promisor, once looked up
+    bool promisorLoaded = false;
+};
+
+// Objects the sending side must transfer for `wants`: each want's history
+// back to the first commit known to be common, and (unless `includeBlobs` is
+// false, for partial clones) the blobs of those commits minus the blobs of the
+// common boundary commits. Blobs are listed first and commits parents first.
+// Shared history the negotiation missed is filtered out by the receiver,
+// which skips objects it already has. A nonzero `depth` stops each walk after
+// that many commits, and so does reaching one of the sender's own shallow
+// commits (`boundary`); commits cut off from their parent either way are
+// added to `shallow`. A commit the walk needs but the sender doesn't have is
+// added to `missing`, and that want's walk stops there.
+static std::vector<std::string> objectsToSend(const std::vector<std::string>& wants,
+                                              const std::unordered_set<std::string>& common,
+                                              const std::function<std::string(const std::string&)>& readObject,
+                                              bool includeBlobs = true, size_t depth = 0,
+                                              std::vector<std::string>* shallow = nullptr,
+                                              const std::unordered_set<std::string>& boundary = {},
+                                              std::vector<std::string>* missing = nullptr) {
+    std::vector<std::string> commits;
+    std::vector<std::string> blobs;
+    std::unordered_set<std::string> seen(common.begin(), common.end());
+    std::unordered_set<std::string> haveBlobs;
+    for (const std::string& hash : common) {
+        for (const auto& file : Commit::deserialize(readObject(hash)).fileBlobs) haveBlobs.insert(file.second);
+    }
+    for (const std::string& want : wants) {
+        std::vector<std::string> chain;
+        for (std::string hash = want; !hash.empty() && seen.insert(hash).second;) {
+            std::string data = readObject(hash);
+            if (data.empty()) {
+                if (missing) missing->push_back(hash);
+                break;
+            }
+            Commit commit = Commit::deserialize(data);
+            chain.push_back(hash);
+            for (const auto& file : commit.fileBlobs) {
+                if (includeBlobs && haveBlobs.insert(file.second).second) blobs.push_back(file.second);
+            }
+            if ((depth > 0 && chain.size() == depth) || boundary.count(hash)) {
+                if (shallow && !commit.parentHash.empty()) shallow->push_back(hash);
+                break;
+            }
+            hash = commit.parentHash;
+        }
+        commits.insert(commits.end(), chain.rbegin(), chain.rend());
+    }
+    blobs.insert(blobs.end(), commits.begin(), commits.end());
+    return blobs;
+}
@@ -0,0 +1,85 @@
+#include <string>
+#include <vector>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+
+// Revision expressions accepted by log, diff and checkout:
+//   <name>        HEAD, a branch, a full commit hash or a unique hash prefix
+//   <rev>~<n>     n-th first-parent ancestor (~ alone means ~1)
+//   <rev>^<n>     n-th parent (^ alone means ^1; commits have a single parent)
+//   A..B          commits reachable from B but not from A
+//   A...B         commits reachable from exactly one of A and B
+//   ^A, --not A   exclude commits reachable from A
+struct RevisionRange {
+    std::vector<std::string> include;  // Tips whose history is shown
+    std::vector<std::string> exclude;  // Tips whose history is hidden
+    bool symmetric = false;            // A...B: hide commits reachable from both sides
+};
+
+// One navigation step applied after the base name: '~' or '^' and a count.
+struct RevisionStep {
+    char op;
+    unsigned long count;
+};
+
+// Splits "main~2^" into base "main" and steps [~2, ^1]. Returns false on
+// malformed suffixes such as "main~x" or a count too large to represent.
+static bool splitRevisionSuffix(const std::string& rev, std::string& base, std::vector<RevisionStep>& steps) {
+    size_t pos = rev.find_first_of("~^");
+    base = rev.substr(0, pos);
+    steps.clear();
+    while (pos != std::string::npos && pos < rev.size()) {
+        char op = rev[pos++];
+        size_t digitsEnd = pos;
+        while (digitsEnd < rev.size() && std::isdigit(static_cast<unsigned char>(rev[digitsEnd]))) ++digitsEnd;
+        unsigned long count = 1;
+        if (digitsEnd > pos) {
+            errno = 0;
+            count = std::strtoul(rev.substr(pos, digitsEnd - pos).c_str(), nullptr, 10);
+            if (errno == ERANGE) return false;
+        }
+        steps.push_back({op, count});
+        pos = digitsEnd;
+        if (pos < rev.size() && rev[pos] != '~' && rev[pos] != '^') return false;
+    }
+    return !base.empty();
+}
+
+// Groups command-line revision arguments into tips to include and exclude.
+// Resolution of the names to commits is left to the caller.
+static bool parseRevisionArgs(const std::vector<std::string>& args, RevisionRange& range) {
+    bool negate = false;
+    for (const std::string& arg : args) {
+        if (arg == "--not") {
+            negate = !negate;
+            continue;
+        }
+        size_t dots = arg.find("..");
+        if (dots != std::string::npos) {
+            bool three = arg.compare(dots, 3, "...") == 0;
+            std::string left = arg.substr(0, dots);
+            std::string right = arg.substr(dots + (three ? 3 : 2));
+            if (left.empty()) left = "HEAD";
+            if (right.empty()) right = "HEAD";
+            if (three) {
+                range.include.push_back(left);
+                range.include.push_back(right);
+                range.symmetric = true;
+            } else {
+                (negate ? range.include : range.exclude).push_back(left);
+                (negate ? range.exclude : range.include).push_back(right);
+            }
+            continue;
+        }
+        bool excluded = negate;
+        std::string name = arg;
+        if (!name.empty() && name[0] == '^') {
+            excluded = !excluded;
+            name = name.substr(1);
+        }
+        if (name.empty()) return false;
+        (excluded ? range.exclude : range.include).push_back(name);
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sys/resource.h>
+
+// Always-on performance counters, reported at exit by 'minigit --stats
+// <command>' (or --stats=json). Each is a relaxed atomic increment, cheap
+// enough to leave in the object layer, the index code and the commands; a
+// jump in e.g. index reads per 'add' shows a regression at a glance.
+struct PerfCounters {
+    std::atomic<uint64_t> objectsRead{0};    // Objects read from disk (cache misses that found the object)
+    std::atomic<uint64_t> objectsWritten{0}; // Loose objects written, plus objects installed in packs
+    std::atomic<uint64_t> bytesRead{0};      // Through FileIO
+    std::atomic<uint64_t> bytesWritten{0};
+    std::atomic<uint64_t> filesStatted{0};   // Existence checks and signatures
+    std::atomic<uint64_t> hashesComputed{0};
+    std::atomic<uint64_t> indexReads{0};     // Staging area parsed from disk
+    std::atomic<uint64_t> indexWrites{0};
+    std::atomic<uint64_t> commands{0};
+    std::atomic<uint64_t> allocations{0};    // Calls to operator new
+
+    static void bump(std::atomic<uint64_t>& counter, uint64_t by = 1) { counter.fetch_add(by, std::memory_order_relaxed); }
+
+    // Peak resident set size of the process so far, in KiB. VmHWM belongs to
+    // this program's address space; ru_maxrss also counts the memory of the
+    // process that forked us before the exec, which skews it when a large
+    // parent (e.g. the benchmark driver) spawns minigit.
+    static long peakRssKiB() {
+        if (FILE* status = std::fopen("/proc/self/status", "r")) {
+            char line[128];
+            long kib = -1;
+            while (kib < 0 && std::fgets(line, sizeof(line), status)) {
+                if (std::strncmp(line, "VmHWM:", 6) == 0) kib = std::strtol(line + 6, nullptr, 10);
+            }
+            std::fclose(status);
+            if (kib >= 0) return kib;
+        }
+        struct rusage usage;
+        return ::getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+    }
+};
+
+static PerfCounters perfCounters;
+
+// Counting every allocation means replacing the global allocator; the array
+// and nothrow forms fall back to these. The deletes are kept out of line so
+// the compiler doesn't pair an inlined free() with operator new and warn.
+void* operator new(std::size_t size) {
+    PerfCounters::bump(perfCounters.allocations);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept { std::free(p); }
@@ -0,0 +1,98 @@
+#include <string>
+#include <cstdio>
+#include <cstring>
+
+// Writes a POSIX (ustar) tar stream: a 512-byte header per file followed by
+// its contents padded to 512 bytes, ending with two zero blocks. Names longer
+// than the header allows are carried in a pax extended header ('x'), and a
+// pax global header ('g') can record the commit an archive was made from.
+class TarWriter {
+public:
+    explicit TarWriter(OutputBuffer& out) : out(out) {}
+
+    void addGlobalComment(const std::string& comment) {
+        std::string records = paxRecord("comment", comment);
+        writeHeader("pax_global_header", records.size(), 0, 'g', 0644);
+        writeData(records.data(), records.size());
+    }
+
+    void addFile(const std::string& path, const std::string& content, long long mtime) {
+        std::string name, prefix;
+        if (!splitName(path, name, prefix)) {
+            std::string records = paxRecord("path", path);
+            writeHeader("PaxHeaders/" + path.substr(0, 80), records.size(), mtime, 'x', 0644);
+            writeData(records.data(), records.size());
+            name = path.substr(0, 100);
+            prefix.clear();
+        }
+        writeHeader(name, content.size(), mtime, '0', 0644, prefix);
+        writeData(content.data(), content.size());
+    }
+
+    void finish() {
+        static const char zeros[1024] = {};
+        out.append(zeros, sizeof(zeros));
+    }
+
+private:
+    // ustar keeps up to 100 bytes of name plus a 155-byte prefix, split at a '/'.
+    static bool splitName(const std::string& path, std::string& name, std::string& prefix) {
+        if (path.size() <= 100) {
+            name = path;
+            prefix.clear();
+            return true;
+        }
+        for (size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+            if (slash <= 155 && path.size() - slash - 1 <= 100) {
+                prefix = path.substr(0, slash);
+                name = path.substr(slash + 1);
+                return !name.empty();
+            }
+        }
+        return false;
+    }
+
+    // "<length> <key>=<value>\n", where the length counts its own digits.
+    static std::string paxRecord(const std::string& key, const std::string& value) {
+        size_t body = key.size() + value.size() + 3; // ' ', '=', '\n'
+        size_t length = body + std::to_string(body).size();
+        if (std::to_string(length).size() != std::to_string(body).size()) ++length;
+        return std::to_string(length) + " " + key + "=" + value + "\n";
+    }
+
+    // Zero-padded octal digits filling all but the field's terminating NUL.
+    static void octal(char* field, size_t width, unsigned long long value) {
+        for (size_t i = width - 1; i-- > 0; value >>= 3) field[i] = static_cast<char>('0' + (value & 7));
+        field[width - 1] = '\0';
+    }
+
+    void writeHeader(const std::string& name, unsigned long long size, long long mtime, char type, unsigned mode,
+                     const std::string& prefix = "") {
+        char header[512];
+        std::memset(header, 0, sizeof(header));
+        std::memcpy(header, name.data(), std::min<size_t>(name.size(), 100));
+        octal(header + 100, 8, mode);
+        octal(header + 108, 8, 0);   // uid
+        octal(header + 116, 8, 0);   // gid
+        octal(header + 124, 12, size);
+        octal(header + 136, 12, static_cast<unsigned long long>(mtime < 0 ? 0 : mtime));
+        header[156] = type;
+        std::memcpy(header + 257, "ustar", 6);
+        std::memcpy(header + 263, "00", 2);
+        std::memcpy(header + 345, prefix.data(), std::min<size_t>(prefix.size(), 155));
+
+        std::memset(header + 148, ' ', 8); // The checksum is computed with its own field as spaces
+        unsigned checksum = 0;
+        for (unsigned char c : header) checksum += c;
+        std::snprintf(header + 148, 8, "%06o", checksum);
+        out.append(header, sizeof(header));
+    }
+
+    void writeData(const char* data, size_t len) {
+        static const char zeros[512] = {};
+        out.append(data, len);
+        if (len % 512) out.append(zeros, 512 - len % 512);
+    }
+
+    OutputBuffer& out;
+};
@@ -0,0 +1,149 @@
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+// Tracing of command phases. With MINIGIT_TRACE=<file> set, every TraceSpan
+// becomes a Chrome trace "complete" event, and the events are written to
+// <file> as JSON when the process exits (load it in chrome://tracing or
+// ui.perfetto.dev). Without it a span costs one test of a flag read once at
+// startup. The main thread is track 1; other threads get sequential ids as they
+// record their first span, so spans from worker threads get their own tracks.
+class Trace {
+public:
+    static bool enabled() { return state().enabled; }
+
+    static void record(const char* name, const char* category, const std::string& detail,
+                       std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+        State& s = state();
+        Event event{name, category, detail, micros(start), micros(end) - micros(start), threadId()};
+        std::lock_guard<std::mutex> guard(s.lock);
+        s.events.push_back(std::move(event));
+    }
+
+private:
+    struct Event {
+        const char* name;
+        const char* category;
+        std::string detail;
+        long long start; // Microseconds since the trace started
+        long long duration;
+        int tid;
+    };
+
+    struct State {
+        bool enabled = false;
+        std::string path;
+        std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+        std::mutex lock;
+        std::vector<Event> events;
+        std::thread::id mainThread = std::this_thread::get_id(); // The first to check enabled()
+        std::atomic<int> nextThread{2};
+    };
+
+    static State& state() {
+        static State* s = []() {
+            State* created = new State(); // Never destroyed: spans may close during static destruction
+            const char* path = std::getenv("MINIGIT_TRACE");
+            if (path && *path) {
+                created->enabled = true;
+                created->path = path;
+                std::atexit(write);
+            }
+            return created;
+        }();
+        return *s;
+    }
+
+    static int threadId() {
+        thread_local int id = std::this_thread::get_id() == state().mainThread ? 1 : state().nextThread++;
+        return id;
+    }
+
+    static long long micros(std::chrono::steady_clock::time_point t) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(t - state().origin).count();
+    }
+
+    static void appendEscaped(std::string& out, const std::string& text) {
+        for (unsigned char c : text) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += static_cast<char>(c);
+            } else if (c < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += static_cast<char>(c);
+            }
+        }
+    }
+
+    static void write() {
+        State& s = state();
+        std::lock_guard<std::mutex> guard(s.lock);
+        std::string pid = std::to_string(::getpid());
+        std::string out = "{\"traceEvents\":[\n";
+        out += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":1,\"args\":{\"name\":\"minigit\"}}";
+        int threads = s.nextThread.load();
+        for (int tid = 1; tid < threads; ++tid) {
+            out += ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" + std::to_string(tid) +
+                   ",\"args\":{\"name\":\"" + (tid == 1 ? std::string("main") : "worker " + std::to_string(tid - 1)) +
+                   "\"}}";
+        }
+        for (const Event& event : s.events) {
+            out += ",\n{\"name\":\"";
+            appendEscaped(out, event.name);
+            out += "\",\"cat\":\"";
+            out += event.category;
+            out += "\",\"ph\":\"X\",\"ts\":" + std::to_string(event.start) + ",\"dur\":" +
+                   std::to_string(event.duration) + ",\"pid\":" + pid + ",\"tid\":" + std::to_string(event.tid);
+            if (!event.detail.empty()) {
+                out += ",\"args\":{\"detail\":\"";
+                appendEscaped(out, event.detail);
+                out += "\"}";
+            }
+            out += "}";
+        }
+        out += "\n],\"displayTimeUnit\":\"ms\"}\n";
+        FILE* file = std::fopen(s.path.c_str(), "w");
+        if (!file) {
+            std::fprintf(stderr, "Error: Could not write trace file %s\n", s.path.c_str());
+            return;
+        }
+        std::fwrite(out.data(), 1, out.size(), file);
+        std::fclose(file);
+    }
+};
+
+// Times the enclosing scope, e.g. `TraceSpan span("readObject", "object", hash);`.
+// `detail` is only copied when tracing is on.
+class TraceSpan {
+public:
+    TraceSpan(const char* name, const char* category, const std::string& detail = std::string())
+        : name(name), category(category), active(Trace::enabled()) {
+        if (active) {
+            this->detail = detail;
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~TraceSpan() {
+        if (active) Trace::record(name, category, detail, start, std::chrono::steady_clock::now());
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    const char* category;
+    bool active;
+    std::string detail;
+    std::chrono::steady_clock::time_point start;
+};
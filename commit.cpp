@@ -1,6 +1,9 @@
 #include <chrono>    // For current time
-#include <ctime>     // For std::put_time, std::localtime
-#include <iomanip>   // For std::put_time
+#include <ctime>     // For localtime_r, gmtime_r, mktime
+#include <iomanip>   // For std::get_time, std::setw
+#include <cstdio>    // For snprintf
+#include <cstdlib>   // For strtoll
+#include <cerrno>
 #include <sstream>
 #include <string>    // For std::string
 #include <string>
@@ -11,7 +14,9 @@ class Commit {
 public:
     std::string hash; // The hash of this commit object
     std::string message;
-    std::string timestamp;
+    long long time;      // Seconds since the epoch
+    int tzOffset;        // Author's time zone, in minutes east of UTC
+    std::string legacyTimestamp; // Original "%Y-%m-%d %H:%M:%S" text of commits written before epoch timestamps
     std::string parentHash; // For simplicity, single parent for now. For merges, this could be a vector.
     std::map<std::string, std::string> fileBlobs; // Filename to blob hash mapping
 
@@ -21,35 +26,109 @@ public:
     std::string serialize() const; // Convert object to string for storage
     static Commit deserialize(const std::string& data); // Convert string back to object
     void computeAndSetHash(); // Computes hash based on serialized content
+    std::string formatDate() const; // Renders the timestamp for display
+    std::string timestampText() const; // The stored form of the timestamp, as written by serialize()
+
+    static bool parseDate(const std::string& text, long long& epoch); // For --since/--until
 };
 
-static std::string computeSimpleHash(const std::string& data) {
-    unsigned long hash = 5381; // djb2 hash constant
-    for (char c : data) {
-        hash = ((hash << 5) + hash) + static_cast<unsigned char>(c); // hash * 33 + c
+// Incremental form of computeSimpleHash, for hashing data that is read in chunks.
+class SimpleHasher {
+public:
+    void update(const char* data, size_t len) {
+        for (size_t i = 0; i < len; ++i) {
+            hash = ((hash << 5) + hash) + static_cast<unsigned char>(data[i]); // hash * 33 + c
+        }
     }
 
-    std::stringstream ss;
-    ss << std::hex << std::setw(16) << std::setfill('0') << hash;
-    return ss.str();
+    std::string hex() const {
+        PerfCounters::bump(perfCounters.hashesComputed);
+        std::stringstream ss;
+        ss << std::hex << std::setw(16) << std::setfill('0') << hash;
+        return ss.str();
+    }
+
+private:
+    unsigned long hash = 5381; // djb2 hash constant
+};
+
+static std::string computeSimpleHash(const std::string& data) {
+    TraceSpan span("computeSimpleHash", "hash");
+    SimpleHasher hasher;
+    hasher.update(data.data(), data.size());
+    return hasher.hex();
 }
 
 
-Commit::Commit() : hash(""), message(""), timestamp(""), parentHash("") {}
+Commit::Commit() : hash(""), message(""), time(0), tzOffset(0), parentHash("") {}
 
 Commit::Commit(const std::string& msg, const std::string& parent)
     : message(msg), parentHash(parent) {
-    auto now = std::chrono::system_clock::now();
-    std::time_t time = std::chrono::system_clock::to_time_t(now);
+    std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::tm local{};
+    localtime_r(&now, &local);
+    time = static_cast<long long>(now);
+    tzOffset = static_cast<int>(local.tm_gmtoff / 60);
+}
+
+// Parses "YYYY-MM-DD HH:MM:SS" (or just the date) as local time.
+static bool parseLocalTime(const std::string& text, long long& epoch, int* tzOffset) {
+    std::tm tm{};
+    std::istringstream ss(text);
+    ss >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
+    if (ss.fail()) {
+        tm = std::tm{};
+        std::istringstream dateOnly(text);
+        dateOnly >> std::get_time(&tm, "%Y-%m-%d");
+        if (dateOnly.fail()) return false;
+    }
+    tm.tm_isdst = -1;
+    std::time_t t = std::mktime(&tm);
+    if (t == static_cast<std::time_t>(-1)) return false;
+    epoch = static_cast<long long>(t);
+    if (tzOffset) *tzOffset = static_cast<int>(tm.tm_gmtoff / 60);
+    return true;
+}
+
+bool Commit::parseDate(const std::string& text, long long& epoch) {
+    if (!text.empty() && text[0] == '@') {
+        try {
+            size_t used = 0;
+            epoch = std::stoll(text.substr(1), &used);
+            return used == text.size() - 1;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return parseLocalTime(text, epoch, nullptr);
+}
+
+std::string Commit::formatDate() const {
+    std::time_t shifted = static_cast<std::time_t>(time + tzOffset * 60LL);
+    std::tm tm{};
+    gmtime_r(&shifted, &tm);
+    int offset = tzOffset < 0 ? -tzOffset : tzOffset;
+    char buf[48];
+    std::snprintf(buf, sizeof(buf), "%04d-%02d-%02d %02d:%02d:%02d %c%02d%02d",
+                  tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+                  tzOffset < 0 ? '-' : '+', offset / 60, offset % 60);
+    return buf;
+}
+
+std::string Commit::timestampText() const {
+    if (!legacyTimestamp.empty()) return legacyTimestamp;
     std::stringstream ss;
-    ss << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S");
-    timestamp = ss.str();
+    int offset = tzOffset < 0 ? -tzOffset : tzOffset;
+    ss << time << " " << (tzOffset < 0 ? '-' : '+')
+       << std::setw(2) << std::setfill('0') << offset / 60
+       << std::setw(2) << std::setfill('0') << offset % 60;
+    return ss.str();
 }
 
 std::string Commit::serialize() const {
     std::stringstream ss;
     ss << "message:" << message << "\n";
-    ss << "timestamp:" << timestamp << "\n";
+    ss << "timestamp:" << timestampText() << "\n";
     ss << "parent:" << parentHash << "\n";
     ss << "files:";
     bool first = true;
@@ -62,6 +141,34 @@ std::string Commit::serialize() const {
     return ss.str();
 }
 
+// Parses "<epoch> <+hhmm>" strictly: decimal seconds that fit a long long and
+// a zone of four digits with minutes below 60. Never throws.
+static bool parseEpochTimestamp(const std::string& value, long long& time, int& tzOffset) {
+    size_t spacePos = value.find(' ');
+    if (spacePos == std::string::npos || spacePos == 0 || spacePos + 6 != value.size()) return false;
+    if (value.find_first_not_of("0123456789") != spacePos) return false;
+    char sign = value[spacePos + 1];
+    if (sign != '+' && sign != '-') return false;
+    if (value.find_first_not_of("0123456789", spacePos + 2) != std::string::npos) return false;
+    errno = 0;
+    long long seconds = std::strtoll(value.c_str(), nullptr, 10);
+    if (errno == ERANGE) return false;
+    int hours = (value[spacePos + 2] - '0') * 10 + (value[spacePos + 3] - '0');
+    int minutes = (value[spacePos + 4] - '0') * 10 + (value[spacePos + 5] - '0');
+    if (minutes >= 60) return false;
+    time = seconds;
+    tzOffset = (sign == '-' ? -1 : 1) * (hours * 60 + minutes);
+    return true;
+}
+
+// Accepts "<epoch> <+hhmm>" and, for older commits, "%Y-%m-%d %H:%M:%S" local time.
+// Anything else is kept verbatim as a legacy timestamp so the object still reads.
+static void parseTimestamp(Commit& c, const std::string& value) {
+    if (parseEpochTimestamp(value, c.time, c.tzOffset)) return;
+    c.legacyTimestamp = value;
+    parseLocalTime(value, c.time, &c.tzOffset);
+}
+
 Commit Commit::deserialize(const std::string& data) {
     Commit c;
     std::stringstream ss(data);
@@ -74,7 +181,7 @@ Commit Commit::deserialize(const std::string& data) {
         std::string value = line.substr(colonPos + 1);
 
         if (key == "message") c.message = value;
-        else if (key == "timestamp") c.timestamp = value;
+        else if (key == "timestamp") parseTimestamp(c, value);
         else if (key == "parent") c.parentHash = value;
         else if (key == "files") {
             std::stringstream filesSs(value);
@@ -93,16 +200,5 @@ Commit Commit::deserialize(const std::string& data) {
 }
 
 void Commit::computeAndSetHash() {
-    std::string contentToHash = "message:" + message + "\n" +
-                                "timestamp:" + timestamp + "\n" +
-                                "parent:" + parentHash + "\n" +
-                                "files:";
-    bool first = true;
-    for (const auto& entry : fileBlobs) {
-        if (!first) contentToHash += ",";
-        contentToHash += entry.first + "=" + entry.second;
-        first = false;
-    }
-    contentToHash += "\n";
-    this->hash = computeSimpleHash(contentToHash); // Call the inlined function
+    this->hash = computeSimpleHash(serialize()); // Hash exactly what gets stored
 }
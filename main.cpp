@@ -1,9 +1,12 @@
 #include "MiniGit.cpp"
+#include "Daemon.cpp"
+#include "Batch.cpp"
 #include <iostream>
 #include <string>
 #include <vector>
 #include <map>
 #include <filesystem>
+#include <csignal>
 
 namespace fs = std::filesystem;
 
@@ -24,17 +27,41 @@ void printUsage(){
     cout << "./minigit init                               ->   initialize an empty git repository in the current dir" << endl;
     cout << "./minigit add <'.'|'file_name(s)'>           ->   add the file(s) to staging area ('.' for all files)" << endl;
     cout << "./minigit commit -m <'commit message'>       ->   commit your staging files" << endl;
-    cout << "./minigit log                                ->   show commit log" << endl;
+    cout << "./minigit log [<revision>...] [-n <count>] [--oneline] [--format=<template>] [--since=<date>] [--until=<date>] [-- <path>...] ->   show commit log" << endl;
     cout << "./minigit branch <branch_name>               ->   create a new branch" << endl;
-    cout << "./minigit checkout <branch_name_or_commit_hash> ->   checkout to a branch or checkout a commit" << endl;
+    cout << "./minigit checkout <branch_name_or_revision> ->   checkout to a branch or checkout a commit (e.g. HEAD~2)" << endl;
     cout << "./minigit merge <branch_name>                ->   merge changes from another branch" << endl;
-    cout << "./minigit diff <file1> <file2>               ->   show differences between two files" << END << endl;
+    cout << "./minigit diff <file1> <file2>               ->   show differences between two files" << endl;
+    cout << "./minigit diff <rev1> <rev2> | <rev1>..<rev2> ->   show differences between two commits" << endl;
+    cout << "./minigit commit-graph write                 ->   cache commit parents and changed-path filters for faster log" << endl;
+    cout << "./minigit bitmap write                       ->   build reachability bitmaps for fast ancestry/counting queries" << endl;
+    cout << "./minigit multi-pack-index write             ->   index every pack in one table so lookups don't probe each pack" << endl;
+    cout << "./minigit is-ancestor <rev1> <rev2>          ->   exit 0 if rev1 is an ancestor of rev2, 1 otherwise" << endl;
+    cout << "./minigit rev-list [--count] <revision>...   ->   list or count the commits selected by revisions/ranges" << endl;
+    cout << "./minigit gc [--prune=<seconds>|--prune=now] ->   remove unreachable objects and pack the rest" << endl;
+    cout << "./minigit fsck                               ->   verify object hashes, refs and commit connectivity" << endl;
+    cout << "./minigit daemon [--stop]                    ->   serve commands from a long-running process (used automatically)" << endl;
+    cout << "./minigit batch [-z]                         ->   run commands read from stdin (one per line, or NUL-separated)" << endl;
+    cout << "./minigit fast-import                        ->   import blobs, commits and branches from a stream on stdin" << endl;
+    cout << "./minigit fast-export [<branch>...]          ->   write the history of branches (default: all) as a fast-import stream" << endl;
+    cout << "./minigit archive [--prefix=<p>] [-z] <rev>  ->   write a tar (or tar.gz with -z) of a commit's files to stdout" << endl;
+    cout << "./minigit clone [--shared] <path> [<dir>]    ->   copy another repository (--shared: borrow its objects via alternates)" << endl;
+    cout << "./minigit clone --filter=blob:none <path>    ->   partial clone: copy commits only, fetch blobs on demand" << endl;
+    cout << "./minigit clone --depth=<n> <path> [<dir>]   ->   shallow clone: only the last <n> commits of each branch" << endl;
+    cout << "./minigit fetch [origin|<path>]              ->   fetch branches of another repository as origin/<branch>" << endl;
+    cout << "./minigit fetch --deepen=<n>|--unshallow     ->   extend a shallow clone's history by <n> commits, or fully" << endl;
+    cout << "./minigit push [-f] [origin|<path>] [<branch>...] -> send branches (default: current) to another repository" << endl;
+    cout << "./minigit bundle create <file> <range>...    ->   write the commits in a range and their objects to one file" << endl;
+    cout << "./minigit bundle verify|unbundle <file>      ->   check a bundle's prerequisites / import it as bundle/<branch>" << endl;
+    cout << "./minigit --stats[=json] <command> ...       ->   run a command, then report performance counters on stderr" << END << endl;
 }
-int main(int argc, char *argv[]) {
-    MiniGit mgit;
-
+// Runs one command line against `mgit` and returns the exit status.
+// Shared by main() and the daemon, which calls it once per client request.
+int runCommand(MiniGit& mgit, int argc, char *argv[]) {
     if (argc >= 2) {
         string command = string(argv[1]);
+        TraceSpan span("command", "command", command);
+        PerfCounters::bump(perfCounters.commands);
 
         if (command == "init") {
             mgit.initRepo();
@@ -74,7 +101,53 @@ int main(int argc, char *argv[]) {
                 cout << "./minigit commit -m 'my commit message'" END << endl;
             }
         } else if (command == "log") {
-            mgit.showLog();
+            LogOptions options;
+            bool validArgs = true;
+            for (int i = 2; i < argc && validArgs; ++i) {
+                string arg = string(argv[i]);
+                string countArg;
+                if (arg == "-n" && i + 1 < argc) {
+                    countArg = string(argv[++i]);
+                } else if (arg.rfind("--max-count=", 0) == 0) {
+                    countArg = arg.substr(12);
+                } else if (arg.rfind("-n", 0) == 0 && arg.size() > 2) {
+                    countArg = arg.substr(2);
+                } else if (arg == "--oneline") {
+                    options.oneline = true;
+                    continue;
+                } else if (arg.rfind("--format=", 0) == 0) {
+                    options.format = arg.substr(9);
+                    continue;
+                } else if (arg.rfind("--since=", 0) == 0 || arg.rfind("--until=", 0) == 0) {
+                    long long& bound = arg[2] == 's' ? options.since : options.until;
+                    if (!Commit::parseDate(arg.substr(8), bound)) {
+                        validArgs = false;
+                    }
+                    continue;
+                } else if (arg == "--not" || arg.empty() || arg[0] != '-') {
+                    options.revisions.push_back(arg);
+                    continue;
+                } else if (arg == "--") {
+                    for (++i; i < argc; ++i) {
+                        options.paths.push_back(string(argv[i]));
+                    }
+                    continue;
+                } else {
+                    validArgs = false;
+                    break;
+                }
+                try {
+                    options.maxCount = stol(countArg);
+                } catch (const exception&) {
+                    validArgs = false;
+                }
+            }
+            if (validArgs) {
+                mgit.showLog(options);
+            } else {
+                cout << RED "invalid arguments!" << endl;
+                cout << "./minigit log [<revision>...] [-n <count>] [--oneline] [--format=<template>] [--since=<date>] [--until=<date>] [-- <path>...]" END << endl;
+            }
         } else if (command == "branch") {
             if (argc < 3) {
                 cout << RED "missing arguments!" << endl;
@@ -103,15 +176,176 @@ int main(int argc, char *argv[]) {
                 mgit.mergeBranch(branchToMerge);
             }
         } else if (command == "diff") {
-            if (argc < 4) {
+            if (argc == 3 && string(argv[2]).find("..") != string::npos) {
+                mgit.diffRevisions({string(argv[2])});
+            } else if (argc < 4) {
                 cout << RED "missing arguments!" << endl;
-                cout << "Provide two file paths e.g." << endl;
-                cout << "./minigit diff <file1> <file2>" END << endl;
+                cout << "Provide two file paths or two revisions e.g." << endl;
+                cout << "./minigit diff <file1> <file2>" << endl;
+                cout << "./minigit diff <revision1> <revision2> or ./minigit diff <revision1>..<revision2>" END << endl;
             } else {
                 string file1 = string(argv[2]);
                 string file2 = string(argv[3]);
-                mgit.diffFiles(file1, file2);
+                if (fs::is_regular_file(file1) && fs::is_regular_file(file2)) {
+                    mgit.diffFiles(file1, file2);
+                } else {
+                    mgit.diffRevisions({file1, file2});
+                }
+            }
+        } else if (command == "commit-graph") {
+            if (argc < 3 || string(argv[2]) != "write") {
+                cout << RED "missing arguments!" << endl;
+                cout << "./minigit commit-graph write" END << endl;
+            } else {
+                mgit.writeCommitGraph();
+            }
+        } else if (command == "bitmap") {
+            if (argc < 3 || string(argv[2]) != "write") {
+                cout << RED "missing arguments!" << endl;
+                cout << "./minigit bitmap write" END << endl;
+            } else {
+                mgit.writeBitmaps();
+            }
+        } else if (command == "multi-pack-index") {
+            if (argc < 3 || string(argv[2]) != "write") {
+                cout << RED "missing arguments!" << endl;
+                cout << "./minigit multi-pack-index write" END << endl;
+            } else {
+                mgit.writeMultiPackIndex();
+            }
+        } else if (command == "is-ancestor") {
+            if (argc < 4) {
+                cout << RED "missing arguments!" << endl;
+                cout << "./minigit is-ancestor <ancestor> <descendant>" END << endl;
+                return 2;
+            }
+            // Answer through the exit status, like 'git merge-base --is-ancestor'.
+            return mgit.isAncestor(string(argv[2]), string(argv[3])) ? 0 : 1;
+        } else if (command == "rev-list") {
+            bool countOnly = false;
+            vector<string> revisions;
+            for (int i = 2; i < argc; ++i) {
+                if (string(argv[i]) == "--count") countOnly = true;
+                else revisions.push_back(string(argv[i]));
+            }
+            mgit.revList(revisions, countOnly);
+        } else if (command == "gc") {
+            long long pruneAge = GC_DEFAULT_PRUNE_AGE;
+            bool validArgs = true;
+            for (int i = 2; i < argc; ++i) {
+                string arg = string(argv[i]);
+                if (arg == "--prune=now") {
+                    pruneAge = 0;
+                } else if (arg.rfind("--prune=", 0) == 0) {
+                    try {
+                        pruneAge = stoll(arg.substr(8));
+                    } catch (const exception&) {
+                        validArgs = false;
+                    }
+                } else {
+                    validArgs = false;
+                }
             }
+            if (validArgs) {
+                mgit.collectGarbage(pruneAge);
+            } else {
+                cout << RED "invalid arguments!" << endl;
+                cout << "./minigit gc [--prune=<seconds>|--prune=now]" END << endl;
+            }
+        } else if (command == "fsck") {
+            // Exit status 1 signals corruption, so scripts can check it.
+            return mgit.checkIntegrity() ? 0 : 1;
+        } else if (command == "fast-import") {
+            return mgit.fastImport(cin) ? 0 : 1;
+        } else if (command == "fast-export") {
+            std::vector<std::string> branches(argv + 2, argv + argc);
+            return mgit.fastExport(branches) ? 0 : 1;
+        } else if (command == "archive") {
+            std::string rev, prefix;
+            bool gzip = false;
+            bool validArgs = true;
+            for (int i = 2; i < argc; ++i) {
+                string arg = argv[i];
+                if (arg == "-z" || arg == "--gzip") {
+                    gzip = true;
+                } else if (arg.rfind("--prefix=", 0) == 0) {
+                    prefix = arg.substr(9);
+                } else if (rev.empty() && arg[0] != '-') {
+                    rev = arg;
+                } else {
+                    validArgs = false;
+                }
+            }
+            if (!validArgs || rev.empty()) {
+                cout << RED "missing arguments!" << endl;
+                cout << "Provide a revision e.g." << endl;
+                cout << "./minigit archive [--prefix=<dir>/] [-z|--gzip] <rev> > out.tar" END << endl;
+                return 1;
+            }
+            return mgit.archive(rev, prefix, gzip) ? 0 : 1;
+        } else if (command == "clone") {
+            bool shared = false, blobless = false;
+            long depth = 0;
+            int first = 2;
+            for (; first < argc && argv[first][0] == '-'; ++first) {
+                string option = argv[first];
+                if (option == "--shared") shared = true;
+                else if (option == "--filter=blob:none") blobless = true;
+                else if (option.rfind("--depth=", 0) == 0) depth = std::atol(option.c_str() + 8);
+                else break;
+            }
+            if (argc <= first || argv[first][0] == '-' || depth < 0 || (shared && (blobless || depth > 0))) {
+                cout << RED "missing arguments!" << endl;
+                cout << "Provide the repository to clone e.g." << endl;
+                cout << "./minigit clone [--shared | --filter=blob:none] [--depth=<n>] <path> [<directory>]" END << endl;
+                return 1;
+            }
+            string source = argv[first];
+            string directory = argc > first + 1 ? string(argv[first + 1]) : "";
+            if (directory.empty()) {
+                std::filesystem::path sourcePath = std::filesystem::path(source).lexically_normal();
+                directory = (sourcePath.has_filename() ? sourcePath.filename() : sourcePath.parent_path().filename()).string();
+            }
+            return mgit.cloneRepository(source, directory, shared, blobless, static_cast<size_t>(depth)) ? 0 : 1;
+        } else if (command == "fetch") {
+            string remote;
+            long deepen = 0;
+            for (int i = 2; i < argc; ++i) {
+                string arg = argv[i];
+                if (arg == "--unshallow") deepen = -1;
+                else if (arg.rfind("--deepen=", 0) == 0) deepen = std::max(1L, std::atol(arg.c_str() + 9));
+                else remote = arg;
+            }
+            return mgit.fetch(remote, deepen) ? 0 : 1;
+        } else if (command == "push") {
+            bool force = false;
+            vector<string> positional;
+            for (int i = 2; i < argc; ++i) {
+                string arg = argv[i];
+                if (arg == "-f" || arg == "--force") force = true;
+                else positional.push_back(arg);
+            }
+            string remote = positional.empty() ? "" : positional[0];
+            vector<string> branches(positional.size() > 1 ? positional.begin() + 1 : positional.end(), positional.end());
+            return mgit.push(remote, branches, force) ? 0 : 1;
+        } else if (command == "bundle") {
+            string action = argc >= 3 ? string(argv[2]) : "";
+            if (action == "create" && argc >= 5) {
+                vector<string> revisions(argv + 4, argv + argc);
+                return mgit.createBundle(argv[3], revisions) ? 0 : 1;
+            } else if (action == "verify" && argc >= 4) {
+                return mgit.verifyBundle(argv[3]) ? 0 : 1;
+            } else if (action == "unbundle" && argc >= 4) {
+                return mgit.unbundle(argv[3]) ? 0 : 1;
+            }
+            cout << RED "missing arguments!" << endl;
+            cout << "./minigit bundle create <file> <rev-range>..." << endl;
+            cout << "./minigit bundle verify <file>" << endl;
+            cout << "./minigit bundle unbundle <file>" END << endl;
+            return 1;
+        } else if (command == "batch") {
+            bool nulDelimited = argc >= 3 && string(argv[2]) == "-z";
+            return runBatch(mgit, nulDelimited, runCommand);
         } else {
             cout << RED "Invalid command: " << command << END << endl;
             printUsage();
@@ -123,3 +357,86 @@ int main(int argc, char *argv[]) {
 
     return 0;
 }
+
+// Prints the counters accumulated by this process to stderr, so they don't
+// mix with the command's own output.
+void printStats(MiniGit& mgit, bool json, double seconds) {
+    cout.flush(); // Keep the report after the output when both go to one terminal
+    ObjectCache::Stats cache = mgit.objectCacheStats();
+    vector<pair<string, unsigned long long>> counters = {
+        {"commands", perfCounters.commands.load()},
+        {"objects_read", perfCounters.objectsRead.load()},
+        {"objects_written", perfCounters.objectsWritten.load()},
+        {"bytes_read", perfCounters.bytesRead.load()},
+        {"bytes_written", perfCounters.bytesWritten.load()},
+        {"cache_hits", cache.hits},
+        {"cache_misses", cache.misses},
+        {"files_statted", perfCounters.filesStatted.load()},
+        {"hashes_computed", perfCounters.hashesComputed.load()},
+        {"index_reads", perfCounters.indexReads.load()},
+        {"index_writes", perfCounters.indexWrites.load()},
+        {"allocations", perfCounters.allocations.load()},
+        {"peak_rss_kib", static_cast<unsigned long long>(PerfCounters::peakRssKiB())},
+    };
+    char elapsed[32];
+    snprintf(elapsed, sizeof(elapsed), "%.3f", seconds);
+    if (json) {
+        string out = string("{\"elapsed_seconds\":") + elapsed;
+        for (const auto& counter : counters) out += ",\"" + counter.first + "\":" + to_string(counter.second);
+        cerr << out << "}" << endl;
+        return;
+    }
+    cerr << CYN "Performance counters:" END << endl;
+    for (const auto& counter : counters) {
+        string name = counter.first;
+        name.resize(18, ' ');
+        cerr << "  " << name << counter.second << endl;
+    }
+    cerr << "  " << string("elapsed_seconds").append(3, ' ') << elapsed << endl;
+}
+
+int main(int argc, char *argv[]) {
+    // Report a closed pipe as EPIPE instead of killing the process, so
+    // streaming commands like 'log' can stop cleanly (e.g. 'minigit log | head').
+    signal(SIGPIPE, SIG_IGN);
+
+    // --stats must come before the command, so it can't clash with the command's own options.
+    bool stats = false, statsJson = false;
+    if (argc >= 2 && (string(argv[1]) == "--stats" || string(argv[1]) == "--stats=json")) {
+        stats = true;
+        statsJson = string(argv[1]) == "--stats=json";
+        argv[1] = argv[0];
+        ++argv;
+        --argc;
+    }
+
+    MiniGit mgit;
+    string command = argc >= 2 ? string(argv[1]) : "";
+
+    if (command == "daemon") {
+        if (argc >= 3 && string(argv[2]) == "--stop") {
+            int status = 0;
+            if (!runThroughDaemon({"daemon", "--stop"}, status)) {
+                cout << RED "No MiniGit daemon is running." END << endl;
+                return 1;
+            }
+            cout << "MiniGit daemon stopped." << endl;
+            return status;
+        }
+        return serveDaemon(mgit, runCommand);
+    }
+
+    // Hand the command to a running daemon, whose caches are already warm.
+    // Counters are per process, so a command run for its stats stays here.
+    if (argc >= 2 && command != "init" && !stats) {
+        vector<string> args(argv + 1, argv + argc);
+        int status = 0;
+        if (runThroughDaemon(args, status)) return status;
+    }
+
+    if (!stats) return runCommand(mgit, argc, argv);
+    auto start = chrono::steady_clock::now();
+    int status = runCommand(mgit, argc, argv);
+    printStats(mgit, statsJson, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    return status;
+}